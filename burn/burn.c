@@ -0,0 +1,523 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Subtitle burn-in filter for raw video.
+ *
+ * Reads raw frames from stdin, renders an ASS/SSA script onto them and
+ * writes the composited frames to stdout, e.g.
+ *
+ *   ffmpeg -i in.mkv -f rawvideo -pix_fmt yuv420p - |
+ *       burn -s 1920x1080 -f yuv420p -r 23.976 subs.ass |
+ *       ffmpeg -f rawvideo -pix_fmt yuv420p -s 1920x1080 -r 23.976 -i - out.mkv
+ *
+ * Frames are processed in batches of consecutive frames. Every worker
+ * thread has its own library, renderer and copy of the track, and renders
+ * a contiguous range of frames of each batch, so rendering runs in
+ * parallel without locks. Collision detection depends on the frames
+ * rendered before, so a worker first renders the few earlier frames that
+ * place the events still on screen at the start of its range, see
+ * catch_up. The output therefore does not depend on the number of
+ * threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ass.h>
+
+#define FRAMES_PER_WORKER 8
+
+typedef enum {
+    FORMAT_YUV420P,
+    FORMAT_RGBA,
+} pix_format;
+
+typedef struct {
+    pthread_t thread;
+    int index;                  // renders range index of every batch
+
+    ASS_Library *library;
+    ASS_Renderer *renderer;
+    ASS_Track *track;
+    long long last_frame;       // last frame rendered, -1 if none
+    char *placed;               // events visited by catch_up
+    long long *frames;          // frames to render in catch_up
+    int n_frames, max_frames;
+} worker_t;
+
+typedef struct {
+    int width, height;
+    pix_format format;
+    size_t frame_size;
+    double fps;
+    double start;               // timestamp of the first frame, ms
+    int verbose;
+
+    unsigned char *frames;      // current batch
+    size_t batch_frames;        // number of frames in the current batch
+    long long batch_start;      // index of the first frame of the batch
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    int round;                  // incremented for every batch
+    int pending;                // workers still busy with the batch
+    int quit;
+
+    int n_workers;
+    worker_t *workers;
+} burn_t;
+
+static burn_t burn;
+
+void msg_callback(int level, const char *fmt, va_list va, void *data)
+{
+    if (level > burn.verbose)
+        return;
+    fprintf(stderr, "libass: ");
+    vfprintf(stderr, fmt, va);
+    fprintf(stderr, "\n");
+}
+
+static int init_worker(worker_t *w, char *subfile)
+{
+    w->last_frame = -1;
+    w->library = ass_library_init();
+    if (!w->library) {
+        fprintf(stderr, "ass_library_init failed!\n");
+        return 0;
+    }
+    ass_set_message_cb(w->library, msg_callback, NULL);
+    ass_set_extract_fonts(w->library, 1);
+
+    w->renderer = ass_renderer_init(w->library);
+    if (!w->renderer) {
+        fprintf(stderr, "ass_renderer_init failed!\n");
+        return 0;
+    }
+    ass_set_frame_size(w->renderer, burn.width, burn.height);
+
+    w->track = ass_read_file(w->library, subfile, NULL);
+    if (!w->track) {
+        fprintf(stderr, "track init failed!\n");
+        return 0;
+    }
+    ass_set_fonts(w->renderer, NULL, "Sans", 1, NULL, 1);
+
+    w->placed = malloc(w->track->n_events + 1);
+    if (!w->placed) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+    return 1;
+}
+
+static void done_worker(worker_t *w)
+{
+    if (w->track)
+        ass_free_track(w->track);
+    if (w->renderer)
+        ass_renderer_done(w->renderer);
+    if (w->library)
+        ass_library_done(w->library);
+    free(w->placed);
+    free(w->frames);
+}
+
+#define _r(c)  ((c)>>24)
+#define _g(c)  (((c)>>16)&0xFF)
+#define _b(c)  (((c)>>8)&0xFF)
+#define _a(c)  ((c)&0xFF)
+
+static void blend_rgba(unsigned char *frame, ASS_Image *img)
+{
+    int x, y;
+    unsigned opacity = 255 - _a(img->color);
+    unsigned r = _r(img->color);
+    unsigned g = _g(img->color);
+    unsigned b = _b(img->color);
+    unsigned char *src = img->bitmap;
+    unsigned char *dst = frame + (img->dst_y * burn.width + img->dst_x) * 4;
+
+    for (y = 0; y < img->h; ++y) {
+        for (x = 0; x < img->w; ++x) {
+            unsigned k = src[x] * opacity / 255;
+            unsigned char *p = dst + x * 4;
+            p[0] = (k * r + (255 - k) * p[0]) / 255;
+            p[1] = (k * g + (255 - k) * p[1]) / 255;
+            p[2] = (k * b + (255 - k) * p[2]) / 255;
+            p[3] = k + (255 - k) * p[3] / 255;
+        }
+        src += img->stride;
+        dst += burn.width * 4;
+    }
+}
+
+static void blend_yuv420p(unsigned char *frame, ASS_Image *img)
+{
+    int x, y;
+    int cw = (burn.width + 1) / 2;
+    int ch = (burn.height + 1) / 2;
+    unsigned opacity = 255 - _a(img->color);
+    int r = _r(img->color);
+    int g = _g(img->color);
+    int b = _b(img->color);
+    // BT.601, limited range
+    int cy = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    int cu = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    int cv = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    unsigned char *plane_y = frame;
+    unsigned char *plane_u = frame + burn.width * burn.height;
+    unsigned char *plane_v = plane_u + cw * ch;
+
+    for (y = 0; y < img->h; ++y) {
+        unsigned char *src = img->bitmap + y * img->stride;
+        unsigned char *dst = plane_y + (img->dst_y + y) * burn.width +
+                             img->dst_x;
+        for (x = 0; x < img->w; ++x) {
+            unsigned k = src[x] * opacity / 255;
+            dst[x] = (k * cy + (255 - k) * dst[x]) / 255;
+        }
+    }
+
+    // chroma: average the coverage of each 2x2 block
+    for (y = img->dst_y & ~1; y < img->dst_y + img->h; y += 2) {
+        int x0 = img->dst_x & ~1;
+        for (x = x0; x < img->dst_x + img->w; x += 2) {
+            unsigned sum = 0;
+            int dx, dy;
+            unsigned k;
+            unsigned char *u, *v;
+            for (dy = 0; dy < 2; ++dy)
+                for (dx = 0; dx < 2; ++dx) {
+                    int sx = x + dx - img->dst_x;
+                    int sy = y + dy - img->dst_y;
+                    if (sx >= 0 && sx < img->w && sy >= 0 && sy < img->h)
+                        sum += img->bitmap[sy * img->stride + sx];
+                }
+            k = (sum / 4) * opacity / 255;
+            u = plane_u + (y / 2) * cw + x / 2;
+            v = plane_v + (y / 2) * cw + x / 2;
+            *u = (k * cu + (255 - k) * *u) / 255;
+            *v = (k * cv + (255 - k) * *v) / 255;
+        }
+    }
+}
+
+static long long frame_time(long long frame)
+{
+    return burn.start + frame * 1000. / burn.fps + 0.5;
+}
+
+/**
+ * \brief Find the first frame that shows an event
+ * \return frame number, -1 if no frame shows it
+ */
+static long long first_frame(ASS_Event *event)
+{
+    long long frame = (event->Start - burn.start) * burn.fps / 1000.;
+
+    if (frame < 0)
+        frame = 0;
+    while (frame > 0 && frame_time(frame - 1) >= event->Start)
+        frame--;
+    while (frame_time(frame) < event->Start)
+        frame++;
+    return frame_time(frame) < event->Start + event->Duration ? frame : -1;
+}
+
+/**
+ * \brief Queue the first frames of the events shown in a frame that were
+ * not placed by the worker yet
+ */
+static int add_first_frames(worker_t *w, long long frame, long long end)
+{
+    long long now = frame_time(frame);
+    int i, j;
+
+    for (i = 0; i < w->track->n_events; ++i) {
+        ASS_Event *event = w->track->events + i;
+        long long first;
+        if (w->placed[i] || event->Start > now ||
+            now >= event->Start + event->Duration)
+            continue;
+        w->placed[i] = 1;
+        first = first_frame(event);
+        if (first <= w->last_frame || first >= end)
+            continue;
+        for (j = 0; j < w->n_frames && w->frames[j] != first; ++j);
+        if (j < w->n_frames)
+            continue;
+        if (w->n_frames == w->max_frames) {
+            int max_frames = w->max_frames ? 2 * w->max_frames : 64;
+            long long *frames = realloc(w->frames,
+                                        max_frames * sizeof(*frames));
+            if (!frames)
+                return 0;
+            w->frames = frames;
+            w->max_frames = max_frames;
+        }
+        w->frames[w->n_frames++] = first;
+    }
+    return 1;
+}
+
+static int cmp_frame(const void *a, const void *b)
+{
+    long long fa = *(const long long *) a;
+    long long fb = *(const long long *) b;
+    return fa < fb ? -1 : fa > fb;
+}
+
+/**
+ * \brief Bring the collision detection state of a worker up to a frame.
+ * An event is placed in the first frame that shows it, around the events
+ * already on screen, which were placed in their own first frames.  So
+ * instead of all frames since the last one it rendered, the worker
+ * renders the first frames of the events on screen in the target frame,
+ * of the events on screen in those frames and so on, in frame order.
+ * Every event then meets the same events on screen as when all frames
+ * are rendered one after the other.
+ * \return 0 on allocation failure
+ */
+static int catch_up(worker_t *w, long long frame)
+{
+    int i;
+
+    memset(w->placed, 0, w->track->n_events);
+    w->n_frames = 0;
+    if (!add_first_frames(w, frame, frame))
+        return 0;
+    for (i = 0; i < w->n_frames; ++i)
+        if (!add_first_frames(w, w->frames[i], frame))
+            return 0;
+
+    qsort(w->frames, w->n_frames, sizeof(*w->frames), cmp_frame);
+    for (i = 0; i < w->n_frames; ++i)
+        ass_render_frame(w->renderer, w->track, frame_time(w->frames[i]),
+                         NULL);
+    return 1;
+}
+
+/**
+ * \brief Render frame n of the batch and blend it
+ * \return 0 on allocation failure
+ */
+static int render_frame(worker_t *w, size_t n)
+{
+    long long frame = burn.batch_start + n;
+    unsigned char *dst = burn.frames + n * burn.frame_size;
+    ASS_Image *img;
+
+    if (frame != w->last_frame + 1 && !catch_up(w, frame))
+        return 0;
+    img = ass_render_frame(w->renderer, w->track, frame_time(frame), NULL);
+    w->last_frame = frame;
+
+    for (; img; img = img->next) {
+        if (img->w <= 0 || img->h <= 0)
+            continue;
+        if (burn.format == FORMAT_RGBA)
+            blend_rgba(dst, img);
+        else
+            blend_yuv420p(dst, img);
+    }
+    return 1;
+}
+
+static void *worker_thread(void *arg)
+{
+    worker_t *w = arg;
+    int round = 0;
+
+    pthread_mutex_lock(&burn.lock);
+    while (1) {
+        size_t i;
+        while (!burn.quit && burn.round == round)
+            pthread_cond_wait(&burn.work_cond, &burn.lock);
+        if (burn.quit)
+            break;
+        round = burn.round;
+        pthread_mutex_unlock(&burn.lock);
+
+        for (i = w->index * FRAMES_PER_WORKER;
+             i < (w->index + 1) * FRAMES_PER_WORKER &&
+             i < burn.batch_frames; ++i)
+            if (!render_frame(w, i)) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+
+        pthread_mutex_lock(&burn.lock);
+        if (--burn.pending == 0)
+            pthread_cond_signal(&burn.done_cond);
+    }
+    pthread_mutex_unlock(&burn.lock);
+    return NULL;
+}
+
+static size_t read_frames(unsigned char *buf, size_t max_frames)
+{
+    size_t total = max_frames * burn.frame_size;
+    size_t done = 0;
+
+    while (done < total) {
+        size_t n = fread(buf + done, 1, total - done, stdin);
+        if (!n)
+            break;
+        done += n;
+    }
+    if (done % burn.frame_size)
+        fprintf(stderr, "Ignoring truncated last frame\n");
+    return done / burn.frame_size;
+}
+
+static void usage(char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options] <subtitle file>\n"
+            "  -s WxH      frame size (required)\n"
+            "  -f format   yuv420p or rgba (default yuv420p)\n"
+            "  -r fps      frame rate (default 25)\n"
+            "  -t start    timestamp of the first frame in seconds\n"
+            "  -j threads  number of worker threads (default: CPU count)\n"
+            "  -v level    libass message level (default 1)\n", name);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt, i;
+    long n_cpus;
+    size_t batch;
+    char *subfile;
+
+    burn.format = FORMAT_YUV420P;
+    burn.fps = 25.;
+    burn.verbose = 1;
+    n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    burn.n_workers = n_cpus > 0 ? n_cpus : 1;
+
+    while ((opt = getopt(argc, argv, "s:f:r:t:j:v:")) != -1) {
+        switch (opt) {
+        case 's':
+            if (sscanf(optarg, "%dx%d", &burn.width, &burn.height) != 2)
+                usage(argv[0]);
+            break;
+        case 'f':
+            if (!strcmp(optarg, "yuv420p"))
+                burn.format = FORMAT_YUV420P;
+            else if (!strcmp(optarg, "rgba"))
+                burn.format = FORMAT_RGBA;
+            else
+                usage(argv[0]);
+            break;
+        case 'r':
+            burn.fps = strtod(optarg, NULL);
+            break;
+        case 't':
+            burn.start = strtod(optarg, NULL) * 1000.;
+            break;
+        case 'j':
+            burn.n_workers = atoi(optarg);
+            break;
+        case 'v':
+            burn.verbose = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || burn.width <= 0 || burn.height <= 0 ||
+        burn.fps <= 0 || burn.n_workers <= 0)
+        usage(argv[0]);
+    subfile = argv[optind];
+
+    if (burn.format == FORMAT_RGBA)
+        burn.frame_size = (size_t) burn.width * burn.height * 4;
+    else
+        burn.frame_size = (size_t) burn.width * burn.height +
+            2 * (size_t) ((burn.width + 1) / 2) * ((burn.height + 1) / 2);
+
+    batch = (size_t) burn.n_workers * FRAMES_PER_WORKER;
+    burn.frames = malloc(batch * burn.frame_size);
+    burn.workers = calloc(burn.n_workers, sizeof(worker_t));
+    if (!burn.frames || !burn.workers) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    pthread_mutex_init(&burn.lock, NULL);
+    pthread_cond_init(&burn.work_cond, NULL);
+    pthread_cond_init(&burn.done_cond, NULL);
+    for (i = 0; i < burn.n_workers; ++i) {
+        burn.workers[i].index = i;
+        if (!init_worker(burn.workers + i, subfile))
+            exit(1);
+    }
+    for (i = 0; i < burn.n_workers; ++i) {
+        if (pthread_create(&burn.workers[i].thread, NULL, worker_thread,
+                           burn.workers + i)) {
+            fprintf(stderr, "pthread_create failed!\n");
+            exit(1);
+        }
+    }
+
+    while (1) {
+        size_t n = read_frames(burn.frames, batch);
+        if (!n)
+            break;
+
+        pthread_mutex_lock(&burn.lock);
+        burn.batch_frames = n;
+        burn.pending = burn.n_workers;
+        burn.round++;
+        pthread_cond_broadcast(&burn.work_cond);
+        while (burn.pending)
+            pthread_cond_wait(&burn.done_cond, &burn.lock);
+        pthread_mutex_unlock(&burn.lock);
+
+        if (fwrite(burn.frames, burn.frame_size, n, stdout) != n) {
+            fprintf(stderr, "Write error\n");
+            break;
+        }
+        burn.batch_start += n;
+        if (n < batch)
+            break;
+    }
+
+    pthread_mutex_lock(&burn.lock);
+    burn.quit = 1;
+    pthread_cond_broadcast(&burn.work_cond);
+    pthread_mutex_unlock(&burn.lock);
+    for (i = 0; i < burn.n_workers; ++i) {
+        pthread_join(burn.workers[i].thread, NULL);
+        done_worker(burn.workers + i);
+    }
+
+    pthread_cond_destroy(&burn.done_cond);
+    pthread_cond_destroy(&burn.work_cond);
+    pthread_mutex_destroy(&burn.lock);
+    free(burn.workers);
+    free(burn.frames);
+
+    return 0;
+}
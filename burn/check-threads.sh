@@ -0,0 +1,33 @@
+#!/bin/sh
+# Check that the burn-in output does not depend on the number of threads.
+# Events overlap and are placed by collision detection, which depends on
+# the frames rendered before.
+tmp=${TMPDIR:-/tmp}/burn-check.$$
+trap 'rm -f "$tmp".*' EXIT
+cat > "$tmp.ass" <<'SCRIPT'
+[Script Info]
+ScriptType: v4.00+
+PlayResX: 64
+PlayResY: 64
+
+[V4+ Styles]
+Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding
+Style: Default,Sans,20,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,0,0,0,0,100,100,0,0,1,0,0,2,0,0,2,1
+
+[Events]
+Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text
+Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,0,0,,{\p1}m 0 0 l 40 0 40 10 0 10{\p0}
+Dialogue: 0,0:00:00.30,0:00:02.00,Default,,0,0,0,,{\p1\c&H0000FF&}m 0 0 l 30 0 30 12 0 12{\p0}
+Dialogue: 0,0:00:00.70,0:00:03.00,Default,,0,0,0,,{\p1\c&H00FF00&}m 0 0 l 50 0 50 8 0 8{\p0}
+Dialogue: 0,0:00:01.50,0:00:03.50,Default,,0,0,0,,{\p1\c&HFF0000&}m 0 0 l 20 0 20 14 0 14{\p0}
+SCRIPT
+frames=100
+size=$((64 * 48 * 4 * frames))
+head -c $size /dev/zero | ./burn -s 64x48 -f rgba -j 1 "$tmp.ass" > "$tmp.1" || exit 1
+for j in 2 3 5; do
+    head -c $size /dev/zero | ./burn -s 64x48 -f rgba -j $j "$tmp.ass" > "$tmp.$j" || exit 1
+    if ! cmp -s "$tmp.1" "$tmp.$j"; then
+        echo "output with -j $j differs from -j 1"
+        exit 1
+    fi
+done
@@ -33,10 +33,14 @@
 #ifdef CONFIG_ICONV
 #include <iconv.h>
 #endif
+#ifdef CONFIG_PTHREAD
+#include <pthread.h>
+#endif
 
 #include "ass.h"
 #include "ass_utils.h"
 #include "ass_library.h"
+#include "ass_text.h"
 
 #define ass_atof(STR) (ass_strtod((STR),NULL))
 
@@ -54,6 +58,19 @@ struct parser_priv {
     char *fontdata;
     int fontdata_size;
     int fontdata_used;
+
+    // storage for event and style strings, used with ass_set_pool_strings
+    int pool_strings;
+    StringPool strings;         // interned names, effects and font names
+    StringPool text;            // event text, dropped by ass_flush_events
+
+    // chunks from ass_queue_chunk, not yet added to the track
+    ASS_Chunk *queue;
+    int queue_size;
+    int queue_max;
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_t queue_lock;
+#endif
 };
 
 #define ASS_STYLES_ALLOC 20
@@ -68,9 +85,15 @@ void ass_free_track(ASS_Track *track)
     int i;
 
     if (track->parser_priv) {
-        free(track->parser_priv->fontname);
-        free(track->parser_priv->fontdata);
-        free(track->parser_priv);
+        ASS_ParserPriv *parser_priv = track->parser_priv;
+        free(parser_priv->fontname);
+        free(parser_priv->fontdata);
+        for (i = 0; i < parser_priv->queue_size; ++i)
+            free(parser_priv->queue[i].data);
+        free(parser_priv->queue);
+#ifdef CONFIG_PTHREAD
+        pthread_mutex_destroy(&parser_priv->queue_lock);
+#endif
     }
     free(track->style_format);
     free(track->event_format);
@@ -86,6 +109,11 @@ void ass_free_track(ASS_Track *track)
     }
     free(track->events);
     free(track->name);
+    if (track->parser_priv) {
+        ass_pool_free(&track->parser_priv->strings);
+        ass_pool_free(&track->parser_priv->text);
+        free(track->parser_priv);
+    }
     free(track);
 }
 
@@ -133,22 +161,57 @@ int ass_alloc_event(ASS_Track *track)
     return eid;
 }
 
+/**
+ * \brief Free a string of an event or style.  With string pooling, strings
+ * set by the parser live in the track's string pools and are freed with
+ * the track; all others are heap allocated.
+ */
+static void free_track_string(ASS_Track *track, char *str)
+{
+    ASS_ParserPriv *parser_priv = track->parser_priv;
+
+    if (parser_priv && parser_priv->pool_strings &&
+        (ass_pool_owns(&parser_priv->strings, str) ||
+         ass_pool_owns(&parser_priv->text, str)))
+        return;
+    free(str);
+}
+
+/**
+ * \brief Replace a string of an event or style by a copy, interned if
+ * string pooling is enabled
+ */
+static void set_track_string(ASS_Track *track, char **dst, const char *str)
+{
+    free_track_string(track, *dst);
+    if (track->parser_priv->pool_strings)
+        *dst = ass_pool_intern(&track->parser_priv->strings, str);
+    else
+        *dst = strdup(str);
+}
+
 void ass_free_event(ASS_Track *track, int eid)
 {
     ASS_Event *event = track->events + eid;
 
-    free(event->Name);
-    free(event->Effect);
-    free(event->Text);
-    free(event->render_priv);
+    free_track_string(track, event->Name);
+    free_track_string(track, event->Effect);
+    free_track_string(track, event->Text);
+    ass_free_render_priv(event->render_priv);
+    event->render_priv = NULL;
+}
+
+void ass_invalidate_event_text(ASS_Track *track, int eid)
+{
+    ass_event_text_changed(track->events + eid);
 }
 
 void ass_free_style(ASS_Track *track, int sid)
 {
     ASS_Style *style = track->styles + sid;
 
-    free(style->Name);
-    free(style->FontName);
+    free_track_string(track, style->Name);
+    free_track_string(track, style->FontName);
 }
 
 // ==============================================================================================
@@ -175,10 +238,10 @@ static void rskip_spaces(char **str, char *limit)
  * The parameters are mostly taken directly from VSFilter source for
  * best compatibility.
  */
-static void set_default_style(ASS_Style *style)
+static void set_default_style(ASS_Track *track, ASS_Style *style)
 {
-    style->Name             = strdup("Default");
-    style->FontName         = strdup("Arial");
+    set_track_string(track, &style->Name, "Default");
+    set_track_string(track, &style->FontName, "Arial");
     style->FontSize         = 18;
     style->PrimaryColour    = 0xffffff00;
     style->SecondaryColour  = 0x00ffff00;
@@ -256,14 +319,12 @@ static int numpad2align(int val)
 
 #define STRVAL(name) \
 	} else if (strcasecmp(tname, #name) == 0) { \
-		if (target->name != NULL) free(target->name); \
-		target->name = strdup(token);
+		set_track_string(track, &target->name, token);
 
 #define STARREDSTRVAL(name) \
     } else if (strcasecmp(tname, #name) == 0) { \
-        if (target->name != NULL) free(target->name); \
         while (*token == '*') ++token; \
-        target->name = strdup(token);
+        set_track_string(track, &target->name, token);
 
 #define COLORVAL(name) \
 	} else if (strcasecmp(tname, #name) == 0) { \
@@ -330,7 +391,7 @@ static int process_event_tail(ASS_Track *track, ASS_Event *event,
         // add "Default" style to the end
         // will be used if track does not contain a default style (or even does not contain styles at all)
         int sid = ass_alloc_style(track);
-        set_default_style(&track->styles[sid]);
+        set_default_style(track, &track->styles[sid]);
         track->default_style = sid;
     }
 
@@ -342,13 +403,19 @@ static int process_event_tail(ASS_Track *track, ASS_Event *event,
         NEXT(q, tname);
         if (strcasecmp(tname, "Text") == 0) {
             char *last;
-            event->Text = strdup(p);
+            if (track->parser_priv->pool_strings)
+                event->Text = ass_pool_strdup(&track->parser_priv->text, p);
+            else
+                event->Text = strdup(p);
             if (*event->Text != 0) {
                 last = event->Text + strlen(event->Text) - 1;
                 if (last >= event->Text && *last == '\r')
                     *last = 0;
             }
             event->Duration -= event->Start;
+            ass_event_text_changed(event);
+            if (track->library->predecode_text)
+                ass_event_decoded_text(event);
             free(format);
             return 0;           // "Text" is always the last
         }
@@ -496,7 +563,7 @@ static int process_style(ASS_Track *track, char *str)
     if (track->n_styles == 0) {
         // will be used if track does not contain a default style (or even does not contain styles at all)
         int sid = ass_alloc_style(track);
-        set_default_style(&track->styles[sid]);
+        set_default_style(track, &track->styles[sid]);
         track->default_style = sid;
     }
 
@@ -564,9 +631,9 @@ static int process_style(ASS_Track *track, char *str)
     style->Underline = !!style->Underline;
     style->StrikeOut = !!style->StrikeOut;
     if (!style->Name)
-        style->Name = strdup("Default");
+        set_track_string(track, &style->Name, "Default");
     if (!style->FontName)
-        style->FontName = strdup("Arial");
+        set_track_string(track, &style->FontName, "Arial");
     free(format);
     return 0;
 
@@ -887,30 +954,81 @@ static int check_duplicate_event(ASS_Track *track, int ReadOrder)
 }
 
 /**
- * \brief Process a chunk of subtitle stream data. In Matroska, this contains exactly 1 event (or a commentary).
- * \param track track
- * \param data string to parse
- * \param size length of data
- * \param timecode starting time of the event (milliseconds)
- * \param duration duration of the event (milliseconds)
-*/
-void ass_process_chunk(ASS_Track *track, char *data, int size,
-                       long long timecode, long long duration)
+ * \brief Set of event ReadOrder values, used to find duplicate events in
+ * a batch of chunks without rescanning the whole track for each one.
+ */
+typedef struct {
+    int *keys;
+    char *used;
+    unsigned mask;
+} ReadOrderSet;
+
+static int read_order_set_init(ReadOrderSet *set, ASS_Track *track,
+                               int n_new)
+{
+    unsigned size = 16;
+
+    while (size < 2 * (unsigned) (track->n_events + n_new))
+        size *= 2;
+    set->keys = malloc(size * sizeof(int));
+    set->used = calloc(size, 1);
+    set->mask = size - 1;
+    if (!set->keys || !set->used) {
+        free(set->keys);
+        free(set->used);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * \brief Find the slot of a ReadOrder value, or the free slot for it.
+ */
+static unsigned read_order_set_slot(ReadOrderSet *set, int ReadOrder)
+{
+    unsigned i = ((unsigned) ReadOrder * 2654435761u) & set->mask;
+
+    while (set->used[i] && set->keys[i] != ReadOrder)
+        i = (i + 1) & set->mask;
+    return i;
+}
+
+static int read_order_set_has(ReadOrderSet *set, int ReadOrder)
+{
+    return set->used[read_order_set_slot(set, ReadOrder)];
+}
+
+/**
+ * \brief Add a ReadOrder value to the set, if not present yet.
+ */
+static void read_order_set_add(ReadOrderSet *set, int ReadOrder)
+{
+    unsigned i = read_order_set_slot(set, ReadOrder);
+
+    set->used[i] = 1;
+    set->keys[i] = ReadOrder;
+}
+
+static void read_order_set_done(ReadOrderSet *set)
+{
+    free(set->keys);
+    free(set->used);
+}
+
+/**
+ * \brief Parse one chunk (NUL-terminated, modified in place) into a new
+ * event.  Duplicates are looked up in set if given, else in the track.
+ * The ReadOrder of a successfully parsed event is added to set.
+ */
+static void process_chunk_str(ASS_Track *track, char *str,
+                              long long timecode, long long duration,
+                              ReadOrderSet *set)
 {
-    char *str;
     int eid;
     char *p;
     char *token;
     ASS_Event *event;
 
-    if (!track->event_format) {
-        ass_msg(track->library, MSGL_WARN, "Event format header missing");
-        return;
-    }
-
-    str = malloc(size + 1);
-    memcpy(str, data, size);
-    str[size] = '\0';
     ass_msg(track->library, MSGL_V, "Event at %" PRId64 ", +%" PRId64 ": %s",
            (int64_t) timecode, (int64_t) duration, str);
 
@@ -922,7 +1040,8 @@ void ass_process_chunk(ASS_Track *track, char *data, int size,
     do {
         NEXT(p, token);
         event->ReadOrder = atoi(token);
-        if (check_duplicate_event(track, event->ReadOrder))
+        if (set ? read_order_set_has(set, event->ReadOrder) :
+            check_duplicate_event(track, event->ReadOrder))
             break;
 
         NEXT(p, token);
@@ -933,14 +1052,170 @@ void ass_process_chunk(ASS_Track *track, char *data, int size,
         event->Start = timecode;
         event->Duration = duration;
 
-        free(str);
+        if (set)
+            read_order_set_add(set, event->ReadOrder);
         return;
 //              dump_events(tid);
     } while (0);
     // some error
     ass_free_event(track, eid);
     track->n_events--;
+}
+
+/**
+ * \brief Process a chunk of subtitle stream data. In Matroska, this contains exactly 1 event (or a commentary).
+ * \param track track
+ * \param data string to parse
+ * \param size length of data
+ * \param timecode starting time of the event (milliseconds)
+ * \param duration duration of the event (milliseconds)
+*/
+void ass_process_chunk(ASS_Track *track, char *data, int size,
+                       long long timecode, long long duration)
+{
+    char *str;
+
+    if (!track->event_format) {
+        ass_msg(track->library, MSGL_WARN, "Event format header missing");
+        return;
+    }
+
+    str = malloc(size + 1);
+    memcpy(str, data, size);
+    str[size] = '\0';
+
+    process_chunk_str(track, str, timecode, duration, NULL);
+    free(str);
+}
+
+/**
+ * \brief Process an array of chunks at once.
+ * Events are allocated in one step and duplicates are found through a
+ * ReadOrder set built once for the batch, so the cost is linear in the
+ * number of events instead of quadratic.
+ */
+void ass_process_chunks(ASS_Track *track, ASS_Chunk *chunks, int n_chunks)
+{
+    ReadOrderSet set;
+    int have_set;
+    char *str = NULL;
+    int str_size = 0;
+    int i;
+
+    if (n_chunks <= 0)
+        return;
+    if (!track->event_format) {
+        ass_msg(track->library, MSGL_WARN, "Event format header missing");
+        return;
+    }
+
+    if (track->max_events < track->n_events + n_chunks) {
+        ASS_Event *events = realloc(track->events, sizeof(ASS_Event) *
+                                    (track->n_events + n_chunks));
+        if (events) {
+            track->events = events;
+            track->max_events = track->n_events + n_chunks;
+        }
+    }
+
+    have_set = read_order_set_init(&set, track, n_chunks);
+    if (have_set)
+        for (i = 0; i < track->n_events; ++i)
+            read_order_set_add(&set, track->events[i].ReadOrder);
+
+    for (i = 0; i < n_chunks; ++i) {
+        ASS_Chunk *chunk = chunks + i;
+        if (chunk->size + 1 > str_size) {
+            free(str);
+            str_size = FFMAX(chunk->size + 1, 2 * str_size);
+            str = malloc(str_size);
+            if (!str)
+                break;
+        }
+        memcpy(str, chunk->data, chunk->size);
+        str[chunk->size] = '\0';
+
+        process_chunk_str(track, str, chunk->timecode, chunk->duration,
+                          have_set ? &set : NULL);
+    }
+
     free(str);
+    if (have_set)
+        read_order_set_done(&set);
+}
+
+/**
+ * \brief Queue a chunk for later addition to the track.
+ * Only the chunk queue is locked, so this never waits for a render.
+ */
+void ass_queue_chunk(ASS_Track *track, char *data, int size,
+                     long long timecode, long long duration)
+{
+    ASS_ParserPriv *parser_priv = track->parser_priv;
+    ASS_Chunk chunk;
+
+    chunk.data = malloc(size);
+    if (!chunk.data)
+        return;
+    memcpy(chunk.data, data, size);
+    chunk.size = size;
+    chunk.timecode = timecode;
+    chunk.duration = duration;
+
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_lock(&parser_priv->queue_lock);
+#endif
+    if (parser_priv->queue_size >= parser_priv->queue_max) {
+        int max = parser_priv->queue_max * 2 + 16;
+        ASS_Chunk *queue = realloc(parser_priv->queue,
+                                   max * sizeof(ASS_Chunk));
+        if (!queue) {
+#ifdef CONFIG_PTHREAD
+            pthread_mutex_unlock(&parser_priv->queue_lock);
+#endif
+            free(chunk.data);
+            return;
+        }
+        parser_priv->queue = queue;
+        parser_priv->queue_max = max;
+    }
+    parser_priv->queue[parser_priv->queue_size++] = chunk;
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_unlock(&parser_priv->queue_lock);
+#endif
+}
+
+/**
+ * \brief Add all queued chunks to the track.
+ * The queue is detached under the lock and parsed without holding it.
+ */
+void ass_process_chunk_queue(ASS_Track *track)
+{
+    ASS_ParserPriv *parser_priv = track->parser_priv;
+    ASS_Chunk *queue;
+    int n, i;
+
+    // chunks stay queued until the codec private data has been parsed
+    if (!track->event_format)
+        return;
+
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_lock(&parser_priv->queue_lock);
+#endif
+    queue = parser_priv->queue;
+    n = parser_priv->queue_size;
+    parser_priv->queue = NULL;
+    parser_priv->queue_size = 0;
+    parser_priv->queue_max = 0;
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_unlock(&parser_priv->queue_lock);
+#endif
+
+    if (n)
+        ass_process_chunks(track, queue, n);
+    for (i = 0; i < n; ++i)
+        free(queue[i].data);
+    free(queue);
 }
 
 /**
@@ -949,12 +1224,25 @@ void ass_process_chunk(ASS_Track *track, char *data, int size,
 */
 void ass_flush_events(ASS_Track *track)
 {
+    ASS_ParserPriv *parser_priv = track->parser_priv;
+
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_lock(&parser_priv->queue_lock);
+#endif
+    while (parser_priv->queue_size)
+        free(parser_priv->queue[--parser_priv->queue_size].data);
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_unlock(&parser_priv->queue_lock);
+#endif
+
     if (track->events) {
         int eid;
         for (eid = 0; eid < track->n_events; eid++)
             ass_free_event(track, eid);
         track->n_events = 0;
     }
+    // nothing refers to event text anymore
+    ass_pool_reset(&parser_priv->text);
 }
 
 #ifdef CONFIG_ICONV
@@ -1309,6 +1597,10 @@ ASS_Track *ass_new_track(ASS_Library *library)
     track->library = library;
     track->ScaledBorderAndShadow = 1;
     track->parser_priv = calloc(1, sizeof(ASS_ParserPriv));
+    track->parser_priv->pool_strings = library->pool_strings;
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_init(&track->parser_priv->queue_lock, NULL);
+#endif
     return track;
 }
 
@@ -87,6 +87,32 @@ typedef enum {
     ASS_SHAPING_COMPLEX
 } ASS_ShapingLevel;
 
+/**
+ * \brief Renderer caches, see ass_get_cache_stats.
+ */
+typedef enum {
+    ASS_CACHE_FONT = 0,
+    ASS_CACHE_OUTLINE,
+    ASS_CACHE_BITMAP,
+    ASS_CACHE_COMPOSITE,
+    ASS_CACHE_GLYPH_METRICS,
+    ASS_CACHE_KERNING
+} ASS_CacheType;
+
+/**
+ * \brief Cache counters.  Sizes and limits are in bytes for the bitmap and
+ * composite caches and in items for the others.  Hit, miss and flush
+ * counts accumulate over the lifetime of the renderer.
+ */
+typedef struct ass_cache_stats {
+    size_t size;            // current size
+    size_t limit;           // size that triggers a flush
+    unsigned items;         // number of cached items
+    unsigned hits;
+    unsigned misses;
+    unsigned flushes;       // number of times the cache was emptied
+} ASS_CacheStats;
+
 /**
  * \brief Return the version of library. This returns the value LIBASS_VERSION
  * was set to when the library was compiled.
@@ -124,6 +150,34 @@ void ass_set_fonts_dir(ASS_Library *priv, const char *fonts_dir);
  */
 void ass_set_extract_fonts(ASS_Library *priv, int extract);
 
+/**
+ * \brief Whether the text of events should be decoded when they are
+ * parsed.  The characters and override block positions are then kept with
+ * every event, and rendering does not decode its UTF-8 text again on every
+ * frame it is visible.  Costs about four bytes per character of event
+ * text.  Events added without parsing are decoded when first rendered.
+ * An application that modifies the Text of an event, in place or by
+ * assigning a new string, has to call ass_invalidate_event_text.
+ * \param priv library handle
+ * \param predecode whether to pre-decode event text
+ */
+void ass_set_predecode_text(ASS_Library *priv, int predecode);
+
+/**
+ * \brief Whether strings of events and styles read by the parser should be
+ * kept in per-track string pools instead of separate heap blocks.  Names,
+ * effects and font names are then shared between all events and styles
+ * that use them, and event text is packed into large blocks.  Applies to
+ * tracks created afterwards.
+ * With this enabled, strings set by the parser are owned by the track and
+ * must not be modified or free()d; to change one, assign a new malloc()ed
+ * string instead, which ass_free_event/ass_free_style will free.  Memory
+ * of parsed event text is kept until ass_flush_events or ass_free_track.
+ * \param priv library handle
+ * \param pool whether to pool parsed strings
+ */
+void ass_set_pool_strings(ASS_Library *priv, int pool);
+
 /**
  * \brief Register style overrides with a library instance.
  * The overrides should have the form [Style.]Param=Value, e.g.
@@ -339,6 +393,83 @@ int ass_fonts_update(ASS_Renderer *priv);
 void ass_set_cache_limits(ASS_Renderer *priv, int glyph_max,
                           int bitmap_max_size);
 
+/**
+ * \brief Size the bitmap and composite caches adaptively.  Their combined
+ * size is kept under the given budget, and the budget is periodically
+ * shifted towards the cache that misses more often because of its limit.
+ * While a budget is set, it overrides the bitmap cache limit set with
+ * ass_set_cache_limits; that limit, including changes made meanwhile,
+ * applies again once the budget is removed.
+ *
+ * \param priv renderer handle
+ * \param budget_mb total size of both caches in MB, 0 to go back to
+ * fixed limits
+ */
+void ass_set_cache_budget(ASS_Renderer *priv, int budget_mb);
+
+/**
+ * \brief Get cache counters.
+ *
+ * \param priv renderer handle
+ * \param type cache to query
+ * \param stats filled in with the counters
+ * \return 0 on success, -1 if the cache does not exist in this build
+ */
+int ass_get_cache_stats(ASS_Renderer *priv, ASS_CacheType type,
+                        ASS_CacheStats *stats);
+
+/**
+ * \brief Set the number of threads used for blurring large bitmaps.
+ * Only has an effect if libass was built with pthreads.  By default
+ * everything is rendered in the calling thread; with more threads, they
+ * are started the first time a bitmap large enough to be split is
+ * blurred.
+ *
+ * \param priv renderer handle
+ * \param n_threads number of threads, 0 for one per CPU (up to 8), 1 to
+ * render in the calling thread only (default)
+ */
+void ass_set_threads(ASS_Renderer *priv, int n_threads);
+
+/**
+ * \brief Load the fonts a track uses ahead of rendering.  Scans the styles
+ * of all events of the track and their \\fn, \\b, \\i and \\r tags, and
+ * loads the selected fonts, including fallback fonts for the characters
+ * drawn with them, into the renderer's font cache.  Call it after
+ * ass_set_fonts, e.g. right after loading the track.
+ *
+ * If libass was built with pthreads, the fonts are loaded by a background
+ * thread and the function returns once the track is scanned; the track may
+ * be modified or freed afterwards.  Rendering does not wait for the
+ * prefetch to finish, but the prefetch pauses while a frame is rendered.
+ * The message callback may be called from the background thread.
+ * ass_renderer_done stops a running prefetch.  Without pthreads, the fonts
+ * are loaded before the function returns.
+ *
+ * Prefetching stops when the font cache reaches its limit (see
+ * ass_set_font_cache_limits), because the next frame would evict the
+ * fonts that are not in use.
+ *
+ * \param priv renderer handle
+ * \param track subtitle track
+ */
+void ass_prefetch_fonts(ASS_Renderer *priv, ASS_Track *track);
+
+/**
+ * \brief Set font and glyph metrics cache limits.  Do not set, or set to
+ * zero, for reasonable defaults.  Limits are enforced between frames.
+ * A full font cache evicts the least recently used fonts, preferring those
+ * without cached glyphs; evicting a font also removes its glyphs from the
+ * glyph and bitmap caches.
+ *
+ * \param priv renderer handle
+ * \param font_max maximum number of cached fonts
+ * \param glyph_metrics_max maximum number of cached glyph metrics, and
+ * of cached kerning pairs
+ */
+void ass_set_font_cache_limits(ASS_Renderer *priv, int font_max,
+                               int glyph_metrics_max);
+
 /**
  * \brief Render a frame, producing a list of ASS_Image.
  * \param priv renderer handle
@@ -350,6 +481,89 @@ void ass_set_cache_limits(ASS_Renderer *priv, int glyph_max,
 ASS_Image *ass_render_frame(ASS_Renderer *priv, ASS_Track *track,
                             long long now, int *detect_change);
 
+/**
+ * \brief Render a frame from several tracks at once, e.g. dialogue and
+ * signs, producing a single list of ASS_Image.  All tracks share the
+ * renderer's caches, and collision detection treats events of the same
+ * layer from different tracks like events of one track.  Within a layer,
+ * events of later tracks are drawn on top.
+ * \param priv renderer handle
+ * \param tracks array of subtitle tracks
+ * \param n_tracks number of tracks
+ * \param now video timestamp in milliseconds
+ * \param detect_change see ass_render_frame
+ */
+ASS_Image *ass_render_frame_multi(ASS_Renderer *priv, ASS_Track **tracks,
+                                  int n_tracks, long long now,
+                                  int *detect_change);
+
+/**
+ * \brief Render the part of a frame that is visible in a rectangle, e.g.
+ * to refresh only the area below an overlay.  Events and glyphs completely
+ * outside the rectangle are not rasterized, and the returned images are
+ * clipped to it.  Inside the rectangle, the result is the same as with
+ * ass_render_frame.
+ * \param priv renderer handle
+ * \param track subtitle track
+ * \param now video timestamp in milliseconds
+ * \param detect_change see ass_render_frame
+ * \param x0, y0 top left corner of the rectangle (inclusive), in pixels
+ * \param x1, y1 bottom right corner of the rectangle (exclusive)
+ */
+ASS_Image *ass_render_frame_roi(ASS_Renderer *priv, ASS_Track *track,
+                                long long now, int *detect_change,
+                                int x0, int y0, int x1, int y1);
+
+
+/**
+ * \brief Render a whole track into a pre-rendered subtitle file, which
+ * can be played back with ass_prerendered_open/ass_prerendered_get.
+ * Renderer settings (frame size etc.) must be set up as for playback.
+ * \param priv renderer handle
+ * \param track subtitle track
+ * \param fname output file name
+ * \param step sampling interval for animated subtitles in milliseconds,
+ * or 0 for the default (40)
+ * \return 0 on success
+ */
+int ass_prerender_track(ASS_Renderer *priv, ASS_Track *track,
+                        const char *fname, int step);
+
+/*
+ * Pre-rendered subtitle playback.  These functions only read the file
+ * written by ass_prerender_track and need no library or renderer.
+ */
+typedef struct ass_prerendered ASS_Prerendered;
+
+/**
+ * \brief Open (memory-map) a pre-rendered subtitle file.
+ * \param fname file name
+ * \return handle or NULL if the file is missing or invalid
+ */
+ASS_Prerendered *ass_prerendered_open(const char *fname);
+
+/**
+ * \brief Get the frame size the file was rendered for.
+ * \param p handle
+ * \param w set to frame width
+ * \param h set to frame height
+ */
+void ass_prerendered_frame_size(ASS_Prerendered *p, int *w, int *h);
+
+/**
+ * \brief Get the images to display at a timestamp.
+ * \param p handle
+ * \param now video timestamp in milliseconds
+ * \return image list, valid until the next call or ass_prerendered_close.
+ * Bitmaps point into the read-only file mapping and must not be modified.
+ */
+ASS_Image *ass_prerendered_get(ASS_Prerendered *p, long long now);
+
+/**
+ * \brief Close a pre-rendered subtitle file.
+ * \param p handle
+ */
+void ass_prerendered_close(ASS_Prerendered *p);
 
 /*
  * The following functions operate on track objects and do not need
@@ -399,6 +613,16 @@ void ass_free_style(ASS_Track *track, int sid);
  */
 void ass_free_event(ASS_Track *track, int eid);
 
+/**
+ * \brief Notify libass that the Text of an event was modified by the
+ * application, in place or by assigning a new string.  Data derived from
+ * the text, e.g. pre-decoded text, is recomputed when the event is next
+ * rendered.  Events read by libass itself need no notification.
+ * \param track track
+ * \param eid event id
+ */
+void ass_invalidate_event_text(ASS_Track *track, int eid);
+
 /**
  * \brief Parse a chunk of subtitle stream data.
  * \param track track
@@ -428,6 +652,53 @@ void ass_process_codec_private(ASS_Track *track, char *data, int size);
 void ass_process_chunk(ASS_Track *track, char *data, int size,
                        long long timecode, long long duration);
 
+/*
+ * A chunk of subtitle stream data, see ass_process_chunk.
+ */
+typedef struct ass_chunk {
+    char *data;                 // chunk data
+    int size;                   // length of data
+    long long timecode;         // starting time of the event (milliseconds)
+    long long duration;         // duration of the event (milliseconds)
+} ASS_Chunk;
+
+/**
+ * \brief Parse an array of chunks of subtitle stream data, each as in
+ * ass_process_chunk.  Faster than calling ass_process_chunk for every
+ * chunk, e.g. when a demuxer has many packets ready after a seek.
+ * \param track track
+ * \param chunks array of chunks
+ * \param n_chunks number of chunks
+ */
+void ass_process_chunks(ASS_Track *track, ASS_Chunk *chunks, int n_chunks);
+
+/**
+ * \brief Queue a chunk of subtitle stream data (see ass_process_chunk)
+ * without modifying the track.  Queued chunks are added to the track by
+ * ass_render_frame, or by ass_process_chunk_queue.
+ *
+ * If libass was built with pthreads, this function may be called from any
+ * thread, also while another thread renders the same track; it never waits
+ * for rendering to finish.  All other functions that modify the track
+ * still must not run concurrently with rendering.
+ * \param track track
+ * \param data string to parse
+ * \param size length of data
+ * \param timecode starting time of the event (milliseconds)
+ * \param duration duration of the event (milliseconds)
+ */
+void ass_queue_chunk(ASS_Track *track, char *data, int size,
+                     long long timecode, long long duration);
+
+/**
+ * \brief Add all chunks queued with ass_queue_chunk to the track.  Called
+ * by ass_render_frame; only needed when the track is used without
+ * rendering, e.g. with ass_step_sub.  Must not run concurrently with
+ * rendering of the same track.
+ * \param track track
+ */
+void ass_process_chunk_queue(ASS_Track *track);
+
 /**
  * \brief Flush buffered events.
  * \param track track
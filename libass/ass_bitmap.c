@@ -296,10 +296,11 @@ void shift_bitmap(Bitmap *bm, int shift_x, int shift_y)
 
 /*
  * Gaussian blur.  An fast pure C implementation from MPlayer.
+ * The result is left in tmp2, see gauss_blur_store.
  */
-void ass_gauss_blur(unsigned char *buffer, unsigned *tmp2,
-                    int width, int height, int stride,
-                    unsigned *m2, int r, int mwidth)
+static void gauss_blur_rows(unsigned char *buffer, unsigned *tmp2,
+                            int width, int height, int stride,
+                            unsigned *m2, int r, int mwidth)
 {
 
     int x, y;
@@ -405,8 +406,18 @@ void ass_gauss_blur(unsigned char *buffer, unsigned *tmp2,
         t++;
     }
 
-    t = tmp2;
-    s = buffer;
+}
+
+/*
+ * Store rows of a gauss_blur_rows result back into a bitmap.
+ */
+static void gauss_blur_store(unsigned char *buffer, unsigned *tmp2,
+                             int width, int height, int stride)
+{
+    int x, y;
+    unsigned char *s = buffer;
+    unsigned *t = tmp2;
+
     for (y = 0; y < height; y++) {
         for (x = 0; x < width; x++) {
             s[x] = t[x] >> 16;
@@ -416,6 +427,97 @@ void ass_gauss_blur(unsigned char *buffer, unsigned *tmp2,
     }
 }
 
+void ass_gauss_blur(unsigned char *buffer, unsigned *tmp2,
+                    int width, int height, int stride,
+                    unsigned *m2, int r, int mwidth)
+{
+    gauss_blur_rows(buffer, tmp2, width, height, stride, m2, r, mwidth);
+    gauss_blur_store(buffer, tmp2, width, height, stride);
+}
+
+typedef struct {
+    unsigned char *buffer;      // first input row of the band
+    unsigned *tmp;
+    int width, height, stride;  // input band dimensions
+    int skip;                   // overlap rows before the output rows
+    int out_h;                  // number of output rows
+    unsigned *m2;
+    int r, mwidth;
+} BlurBand;
+
+static void blur_band_rows(void *job)
+{
+    BlurBand *b = job;
+    gauss_blur_rows(b->buffer, b->tmp, b->width, b->height, b->stride,
+                    b->m2, b->r, b->mwidth);
+}
+
+static void blur_band_store(void *job)
+{
+    BlurBand *b = job;
+    gauss_blur_store(b->buffer + b->skip * b->stride,
+                     b->tmp + b->skip * (b->width + 1),
+                     b->width, b->out_h, b->stride);
+}
+
+/*
+ * Gaussian blur of a bitmap, split into horizontal bands that are blurred
+ * in parallel on a worker pool.  Every band is blurred together with r
+ * rows of its neighbours on each side, which is all a row of the result
+ * depends on, so the output is identical to ass_gauss_blur.  Small
+ * bitmaps are blurred in one piece.
+ */
+void ass_gauss_blur_bitmap(ASS_SynthPriv *priv, ASS_WorkerPool *pool,
+                           Bitmap *bm)
+{
+    BlurBand bands[WORKER_MAX_THREADS + 1];
+    int r = priv->g_r;
+    int n_bands = ass_worker_pool_threads(pool);
+    int band_h, rows, i, y;
+    unsigned *tmp;
+
+    // bands much thinner than the overlap would mostly redo work
+    n_bands = FFMIN(n_bands, bm->h / FFMAX(2 * r, BLUR_BAND_MIN_HEIGHT));
+    if (n_bands < 2 || (size_t) bm->w * bm->h < BLUR_TILE_MIN_AREA) {
+        resize_tmp(priv, bm->w, bm->h);
+        ass_gauss_blur(bm->buffer, priv->tmp, bm->w, bm->h, bm->stride,
+                       priv->gt2, r, priv->g_w);
+        return;
+    }
+
+    band_h = (bm->h + n_bands - 1) / n_bands;
+    rows = 0;
+    for (i = 0, y = 0; i < n_bands; i++, y += band_h) {
+        BlurBand *b = bands + i;
+        int y0 = FFMAX(y - r, 0);
+        int y1 = FFMIN(y + band_h + r, bm->h);
+        b->buffer = bm->buffer + y0 * bm->stride;
+        b->width = bm->w;
+        b->height = y1 - y0;
+        b->stride = bm->stride;
+        b->skip = y - y0;
+        b->out_h = FFMIN(band_h, bm->h - y);
+        b->m2 = priv->gt2;
+        b->r = r;
+        b->mwidth = priv->g_w;
+        rows += b->height;
+    }
+
+    // all bands share the synth tmp buffer, one slice each
+    resize_tmp(priv, bm->w, rows);
+    tmp = priv->tmp;
+    for (i = 0; i < n_bands; i++) {
+        bands[i].tmp = tmp;
+        tmp += bands[i].height * (bm->w + 1);
+    }
+
+    // bands read their neighbours' rows, so store only when all are done
+    ass_worker_pool_run(pool, blur_band_rows, bands, sizeof(*bands),
+                        n_bands);
+    ass_worker_pool_run(pool, blur_band_store, bands, sizeof(*bands),
+                        n_bands);
+}
+
 /**
  * \brief Blur with [[1,2,1]. [2,4,2], [1,2,1]] kernel
  * This blur is the same as the one employed by vsfilter.
@@ -23,6 +23,11 @@
 #include FT_GLYPH_H
 
 #include "ass.h"
+#include "ass_worker.h"
+
+// minimum bitmap area and band height for parallel gaussian blur
+#define BLUR_TILE_MIN_AREA (512 * 512)
+#define BLUR_BAND_MIN_HEIGHT 64
 
 typedef struct ass_synth_priv {
     int tmp_w, tmp_h;
@@ -72,6 +77,8 @@ void ass_free_bitmap(Bitmap *bm);
 void ass_gauss_blur(unsigned char *buffer, unsigned *tmp2,
                     int width, int height, int stride,
                     unsigned *m2, int r, int mwidth);
+void ass_gauss_blur_bitmap(ASS_SynthPriv *priv, ASS_WorkerPool *pool,
+                           Bitmap *bm);
 void be_blur_c(uint8_t *buf, intptr_t w,
                intptr_t h, intptr_t stride,
                uint16_t *tmp);
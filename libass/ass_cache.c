@@ -36,20 +36,20 @@
 #include "ass_cache_template.h"
 
 // font cache
-static unsigned font_hash(void *buf, size_t len)
+static inline uint64_t font_hash(void *buf, size_t len)
 {
     ASS_FontDesc *desc = buf;
-    unsigned hval;
-    hval = fnv_32a_str(desc->family, FNV1_32A_INIT);
-    hval = fnv_32a_buf(&desc->bold, sizeof(desc->bold), hval);
-    hval = fnv_32a_buf(&desc->italic, sizeof(desc->italic), hval);
-    hval = fnv_32a_buf(&desc->treat_family_as_pattern,
+    uint64_t hval;
+    hval = ass_hash_str(desc->family, ASS_HASH_INIT);
+    hval = ass_hash_buf(&desc->bold, sizeof(desc->bold), hval);
+    hval = ass_hash_buf(&desc->italic, sizeof(desc->italic), hval);
+    hval = ass_hash_buf(&desc->treat_family_as_pattern,
             sizeof(desc->treat_family_as_pattern), hval);
-    hval = fnv_32a_buf(&desc->vertical, sizeof(desc->vertical), hval);
+    hval = ass_hash_buf(&desc->vertical, sizeof(desc->vertical), hval);
     return hval;
 }
 
-static unsigned font_compare(void *key1, void *key2, size_t key_size)
+static inline unsigned font_compare(void *key1, void *key2, size_t key_size)
 {
     ASS_FontDesc *a = key1;
     ASS_FontDesc *b = key2;
@@ -99,7 +99,7 @@ static size_t bitmap_size(void *value, size_t value_size)
     return 0;
 }
 
-static unsigned bitmap_hash(void *key, size_t key_size)
+static inline uint64_t bitmap_hash(void *key, size_t key_size)
 {
     BitmapHashKey *k = key;
     switch (k->type) {
@@ -109,7 +109,7 @@ static unsigned bitmap_hash(void *key, size_t key_size)
     }
 }
 
-static unsigned bitmap_compare (void *a, void *b, size_t key_size)
+static inline unsigned bitmap_compare(void *a, void *b, size_t key_size)
 {
     BitmapHashKey *ak = a;
     BitmapHashKey *bk = b;
@@ -149,7 +149,7 @@ static size_t composite_size(void *value, size_t value_size)
 
 // outline cache
 
-static unsigned outline_hash(void *key, size_t key_size)
+static inline uint64_t outline_hash(void *key, size_t key_size)
 {
     OutlineHashKey *k = key;
     switch (k->type) {
@@ -159,7 +159,7 @@ static unsigned outline_hash(void *key, size_t key_size)
     }
 }
 
-static unsigned outline_compare(void *a, void *b, size_t key_size)
+static inline unsigned outline_compare(void *a, void *b, size_t key_size)
 {
     OutlineHashKey *ak = a;
     OutlineHashKey *bk = b;
@@ -181,19 +181,65 @@ static void outline_destruct(void *key, void *value)
         outline_free(v->lib, v->border);
     if (k->type == OUTLINE_DRAWING)
         free(k->u.drawing.text);
+    else
+        k->u.glyph.font->refs--;
     free(key);
     free(value);
 }
 
+// glyph metrics cache
+static void glyph_metrics_destruct(void *key, void *value)
+{
+    GlyphMetricsHashKey *k = key;
+    k->font->refs--;
+    free(key);
+    free(value);
+}
+
+// kerning cache
+static void kerning_destruct(void *key, void *value)
+{
+    KerningHashKey *k = key;
+    k->font->refs--;
+    free(key);
+    free(value);
+}
+
+// Glyph outline, metrics and kerning keys reference their font, so that
+// the font cache can tell which fonts are safe to evict.  The typed put
+// functions take the reference and the destructors above drop it.
+static inline void no_ref(void *key)
+{
+}
+
+static inline void outline_ref(OutlineHashKey *key)
+{
+    if (key->type == OUTLINE_GLYPH)
+        key->u.glyph.font->refs++;
+}
+
+static inline void glyph_metrics_ref(GlyphMetricsHashKey *key)
+{
+    key->font->refs++;
+}
+
+static inline void kerning_ref(KerningHashKey *key)
+{
+    key->font->refs++;
+}
+
 
 
 // Cache data
 typedef struct cache_item {
+    uint64_t hash;              // finalized key hash, checked before compare
     void *key;
     void *value;
     struct cache_item *next;
 } CacheItem;
 
+#define CACHE_BUCKETS 0x10000   // must be a power of two
+
 struct cache {
     unsigned buckets;
     CacheItem **map;
@@ -209,12 +255,13 @@ struct cache {
     unsigned hits;
     unsigned misses;
     unsigned items;
+    unsigned flushes;
 };
 
 // Hash for a simple (single value or array) type
-static unsigned hash_simple(void *key, size_t key_size)
+static uint64_t hash_simple(void *key, size_t key_size)
 {
-    return fnv_32a_buf(key, key_size, FNV1_32A_INIT);
+    return ass_hash_buf(key, key_size, ASS_HASH_INIT);
 }
 
 // Comparison of a simple type
@@ -237,7 +284,7 @@ Cache *ass_cache_create(HashFunction hash_func, HashCompare compare_func,
                         size_t key_size, size_t value_size)
 {
     Cache *cache = calloc(1, sizeof(*cache));
-    cache->buckets = 0xFFFF;
+    cache->buckets = CACHE_BUCKETS;
     cache->hash_func = hash_simple;
     cache->compare_func = compare_simple;
     cache->destruct_func = destruct_simple;
@@ -255,12 +302,13 @@ Cache *ass_cache_create(HashFunction hash_func, HashCompare compare_func,
     return cache;
 }
 
-void *ass_cache_put(Cache *cache, void *key, void *value)
+static inline void *
+cache_put(Cache *cache, void *key, void *value, uint64_t hash)
 {
-    unsigned bucket = cache->hash_func(key, cache->key_size) % cache->buckets;
-    CacheItem **bucketptr = &cache->map[bucket];
+    CacheItem **bucketptr = &cache->map[hash & (cache->buckets - 1)];
 
     CacheItem *item = calloc(1, sizeof(CacheItem));
+    item->hash = hash;
     item->key = malloc(cache->key_size);
     item->value = malloc(cache->value_size);
     memcpy(item->key, key, cache->key_size);
@@ -278,21 +326,84 @@ void *ass_cache_put(Cache *cache, void *key, void *value)
     return item->value;
 }
 
-void *ass_cache_get(Cache *cache, void *key)
+static inline CacheItem *
+cache_find(Cache *cache, void *key, uint64_t hash, HashCompare compare)
 {
-    unsigned bucket = cache->hash_func(key, cache->key_size) % cache->buckets;
-    CacheItem *item = cache->map[bucket];
+    CacheItem *item = cache->map[hash & (cache->buckets - 1)];
     while (item) {
-        if (cache->compare_func(key, item->key, cache->key_size)) {
-            cache->hits++;
-            return item->value;
-        }
+        if (item->hash == hash && compare(key, item->key, cache->key_size))
+            return item;
         item = item->next;
     }
+    return NULL;
+}
+
+static inline void *
+cache_get(Cache *cache, void *key, uint64_t hash, HashCompare compare)
+{
+    CacheItem *item = cache_find(cache, key, hash, compare);
+    if (item) {
+        cache->hits++;
+        return item->value;
+    }
     cache->misses++;
     return NULL;
 }
 
+void *ass_cache_put(Cache *cache, void *key, void *value)
+{
+    return cache_put(cache, key, value,
+            ass_hash_final(cache->hash_func(key, cache->key_size)));
+}
+
+void *ass_cache_get(Cache *cache, void *key)
+{
+    return cache_get(cache, key,
+            ass_hash_final(cache->hash_func(key, cache->key_size)),
+            cache->compare_func);
+}
+
+/**
+ * \brief Check whether a key is cached.  Unlike ass_cache_get, this does
+ * not count as a hit or miss, so the statistics only reflect rendering.
+ */
+int ass_cache_contains(Cache *cache, void *key)
+{
+    return cache_find(cache, key,
+            ass_hash_final(cache->hash_func(key, cache->key_size)),
+            cache->compare_func) != NULL;
+}
+
+// Typed lookups for the built-in caches.  These call the hash and compare
+// functions of the key type directly, so the compiler can inline them
+// instead of going through the function pointers of the cache.
+#define CACHE_ACCESSORS(name, key_type, value_type, hash, compare, ref) \
+    value_type *ass_##name##_cache_get(Cache *cache, key_type *key) \
+    { \
+        return cache_get(cache, key, \
+                ass_hash_final(hash(key, sizeof(*key))), compare); \
+    } \
+    value_type *ass_##name##_cache_put(Cache *cache, key_type *key, \
+                                       value_type *value) \
+    { \
+        ref(key); \
+        return cache_put(cache, key, value, \
+                ass_hash_final(hash(key, sizeof(*key)))); \
+    }
+
+CACHE_ACCESSORS(font, ASS_FontDesc, ASS_Font, font_hash, font_compare,
+                no_ref)
+CACHE_ACCESSORS(outline, OutlineHashKey, OutlineHashValue,
+                outline_hash, outline_compare, outline_ref)
+CACHE_ACCESSORS(glyph_metrics, GlyphMetricsHashKey, GlyphMetricsHashValue,
+                glyph_metrics_hash, glyph_metrics_compare, glyph_metrics_ref)
+CACHE_ACCESSORS(bitmap, BitmapHashKey, BitmapHashValue,
+                bitmap_hash, bitmap_compare, no_ref)
+CACHE_ACCESSORS(composite, CompositeHashKey, CompositeHashValue,
+                composite_hash, composite_compare, no_ref)
+CACHE_ACCESSORS(kerning, KerningHashKey, KerningHashValue,
+                kerning_hash, kerning_compare, kerning_ref)
+
 int ass_cache_empty(Cache *cache, size_t max_size)
 {
     int i;
@@ -300,6 +411,9 @@ int ass_cache_empty(Cache *cache, size_t max_size)
     if (cache->cache_size < max_size)
         return 0;
 
+    if (cache->items)
+        cache->flushes++;
+
     for (i = 0; i < cache->buckets; i++) {
         CacheItem *item = cache->map[i];
         while (item) {
@@ -311,22 +425,86 @@ int ass_cache_empty(Cache *cache, size_t max_size)
         cache->map[i] = NULL;
     }
 
-    cache->items = cache->hits = cache->misses = cache->cache_size = 0;
+    cache->items = cache->cache_size = 0;
 
     return 1;
 }
 
-void ass_cache_stats(Cache *cache, size_t *size, unsigned *hits,
-                     unsigned *misses, unsigned *count)
+/**
+ * \brief Remove the items selected by a filter
+ * \param filter returns nonzero for items to remove
+ * \param priv passed to filter
+ * \return number of removed items
+ */
+unsigned ass_cache_remove_if(Cache *cache, CacheItemFilter filter,
+                             void *priv)
 {
-    if (size)
-        *size = cache->cache_size;
-    if (hits)
-        *hits = cache->hits;
-    if (misses)
-        *misses = cache->misses;
-    if (count)
-        *count = cache->items;
+    unsigned i, removed = 0;
+
+    for (i = 0; i < cache->buckets; i++) {
+        CacheItem **itemptr = &cache->map[i];
+        while (*itemptr) {
+            CacheItem *item = *itemptr;
+            if (!filter(item->key, item->value, priv)) {
+                itemptr = &item->next;
+                continue;
+            }
+            *itemptr = item->next;
+            if (cache->size_func)
+                cache->cache_size -=
+                    cache->size_func(item->value, cache->value_size);
+            else
+                cache->cache_size--;
+            cache->destruct_func(item->key, item->value);
+            free(item);
+            removed++;
+        }
+    }
+    cache->items -= removed;
+
+    return removed;
+}
+
+/**
+ * \brief Call a function for every item
+ */
+void ass_cache_foreach(Cache *cache, CacheItemVisitor visit, void *priv)
+{
+    unsigned i;
+    CacheItem *item;
+
+    for (i = 0; i < cache->buckets; i++)
+        for (item = cache->map[i]; item; item = item->next)
+            visit(item->key, item->value, priv);
+}
+
+void ass_cache_stats(Cache *cache, ASS_CacheStats *stats)
+{
+    stats->size = cache->cache_size;
+    stats->items = cache->items;
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->flushes = cache->flushes;
+}
+
+/**
+ * \brief Count buckets by chain length
+ * \param hist receives the number of buckets with i items in hist[i];
+ * the last element also counts all longer chains
+ * \param n number of elements in hist
+ */
+void ass_cache_chain_histogram(Cache *cache, unsigned *hist, int n)
+{
+    unsigned i;
+
+    memset(hist, 0, n * sizeof(*hist));
+    for (i = 0; i < cache->buckets; i++) {
+        CacheItem *item;
+        int len = 0;
+        for (item = cache->map[i]; item; item = item->next)
+            len++;
+        hist[FFMIN(len, n - 1)]++;
+    }
 }
 
 void ass_cache_done(Cache *cache)
@@ -351,9 +529,9 @@ Cache *ass_outline_cache_create(void)
 
 Cache *ass_glyph_metrics_cache_create(void)
 {
-    return ass_cache_create(glyph_metrics_hash, glyph_metrics_compare, NULL,
-            (ItemSize) NULL, sizeof(GlyphMetricsHashKey),
-            sizeof(GlyphMetricsHashValue));
+    return ass_cache_create(glyph_metrics_hash, glyph_metrics_compare,
+            glyph_metrics_destruct, (ItemSize) NULL,
+            sizeof(GlyphMetricsHashKey), sizeof(GlyphMetricsHashValue));
 }
 
 Cache *ass_bitmap_cache_create(void)
@@ -368,3 +546,10 @@ Cache *ass_composite_cache_create(void)
             composite_destruct, composite_size, sizeof(CompositeHashKey),
             sizeof(CompositeHashValue));
 }
+
+Cache *ass_kerning_cache_create(void)
+{
+    return ass_cache_create(kerning_hash, kerning_compare, kerning_destruct,
+            (ItemSize) NULL, sizeof(KerningHashKey),
+            sizeof(KerningHashValue));
+}
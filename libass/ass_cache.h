@@ -20,6 +20,8 @@
 #ifndef LIBASS_CACHE_H
 #define LIBASS_CACHE_H
 
+#include <stdint.h>
+
 #include "ass.h"
 #include "ass_font.h"
 #include "ass_bitmap.h"
@@ -48,21 +50,28 @@ typedef struct {
     FT_BBox bbox_scaled;        // bbox after scaling, but before rotation
     FT_Vector advance;          // 26.6, advance distance to the next outline in line
     int asc, desc;              // ascender/descender
+    int evicted;                // being removed along with its font
 } OutlineHashValue;
 
 typedef struct {
     FT_Glyph_Metrics metrics;
 } GlyphMetricsHashValue;
 
+typedef struct {
+    FT_Vector kern;             // 26.6, as returned by FT_Get_Kerning
+} KerningHashValue;
+
 // Create definitions for bitmap, outline and composite hash keys
 #define CREATE_STRUCT_DEFINITIONS
 #include "ass_cache_template.h"
 
 // Type-specific function pointers
-typedef unsigned(*HashFunction)(void *key, size_t key_size);
+typedef uint64_t(*HashFunction)(void *key, size_t key_size);
 typedef size_t(*ItemSize)(void *value, size_t value_size);
 typedef unsigned(*HashCompare)(void *a, void *b, size_t key_size);
 typedef void(*CacheItemDestructor)(void *key, void *value);
+typedef int(*CacheItemFilter)(void *key, void *value, void *priv);
+typedef void(*CacheItemVisitor)(void *key, void *value, void *priv);
 
 // cache hash keys
 
@@ -93,14 +102,43 @@ Cache *ass_cache_create(HashFunction hash_func, HashCompare compare_func,
                         size_t key_size, size_t value_size);
 void *ass_cache_put(Cache *cache, void *key, void *value);
 void *ass_cache_get(Cache *cache, void *key);
+int ass_cache_contains(Cache *cache, void *key);
 int ass_cache_empty(Cache *cache, size_t max_size);
-void ass_cache_stats(Cache *cache, size_t *size, unsigned *hits,
-                     unsigned *misses, unsigned *count);
+unsigned ass_cache_remove_if(Cache *cache, CacheItemFilter filter,
+                             void *priv);
+void ass_cache_foreach(Cache *cache, CacheItemVisitor visit, void *priv);
+void ass_cache_stats(Cache *cache, ASS_CacheStats *stats);
+void ass_cache_chain_histogram(Cache *cache, unsigned *hist, int n);
 void ass_cache_done(Cache *cache);
 Cache *ass_font_cache_create(void);
 Cache *ass_outline_cache_create(void);
 Cache *ass_glyph_metrics_cache_create(void);
 Cache *ass_bitmap_cache_create(void);
 Cache *ass_composite_cache_create(void);
+Cache *ass_kerning_cache_create(void);
+
+// typed get/put for the caches above, see CACHE_ACCESSORS
+ASS_Font *ass_font_cache_get(Cache *cache, ASS_FontDesc *key);
+ASS_Font *ass_font_cache_put(Cache *cache, ASS_FontDesc *key,
+                             ASS_Font *value);
+OutlineHashValue *ass_outline_cache_get(Cache *cache, OutlineHashKey *key);
+OutlineHashValue *ass_outline_cache_put(Cache *cache, OutlineHashKey *key,
+                                        OutlineHashValue *value);
+GlyphMetricsHashValue *
+ass_glyph_metrics_cache_get(Cache *cache, GlyphMetricsHashKey *key);
+GlyphMetricsHashValue *
+ass_glyph_metrics_cache_put(Cache *cache, GlyphMetricsHashKey *key,
+                            GlyphMetricsHashValue *value);
+BitmapHashValue *ass_bitmap_cache_get(Cache *cache, BitmapHashKey *key);
+BitmapHashValue *ass_bitmap_cache_put(Cache *cache, BitmapHashKey *key,
+                                      BitmapHashValue *value);
+CompositeHashValue *ass_composite_cache_get(Cache *cache,
+                                            CompositeHashKey *key);
+CompositeHashValue *ass_composite_cache_put(Cache *cache,
+                                            CompositeHashKey *key,
+                                            CompositeHashValue *value);
+KerningHashValue *ass_kerning_cache_get(Cache *cache, KerningHashKey *key);
+KerningHashValue *ass_kerning_cache_put(Cache *cache, KerningHashKey *key,
+                                        KerningHashValue *value);
 
 #endif                          /* LIBASS_CACHE_H */
@@ -15,42 +15,55 @@
 
 #elif defined(CREATE_COMPARISON_FUNCTIONS)
 #undef CREATE_COMPARISON_FUNCTIONS
+// GENERIC and FTVECTOR members form one fixed-layout block that is
+// compared with a single memcmp; keys must be zeroed before they are
+// filled so that padding compares equal.  STRING and BITMAPHASHKEY
+// members must follow all of them.
 #define START(funcname, structname) \
-    static unsigned funcname##_compare(void *key1, void *key2, size_t key_size) \
+    static inline unsigned \
+    funcname##_compare(void *key1, void *key2, size_t key_size) \
     { \
         struct structname *a = key1; \
         struct structname *b = key2; \
-        return // conditions follow
+        size_t fixed = 0; // size of the fixed-layout block
 #define GENERIC(type, member) \
-            a->member == b->member &&
+        fixed = (char *) &a->member - (char *) a + sizeof(a->member);
 #define STRING(member) \
-            strcmp(a->member, b->member) == 0 &&
-#define FTVECTOR(member) \
-            a->member.x == b->member.x && a->member.y == b->member.y &&
+        if (memcmp(a, b, fixed) || strcmp(a->member, b->member)) \
+            return 0; \
+        fixed = 0;
+#define FTVECTOR(member) GENERIC(FT_Vector, member)
 #define BITMAPHASHKEY(member) \
-            bitmap_compare(&a->member, &b->member, sizeof(a->member)) &&
+        if (memcmp(a, b, fixed) || \
+            !bitmap_compare(&a->member, &b->member, sizeof(a->member))) \
+            return 0; \
+        fixed = 0;
 #define END(typedefname) \
-            1; \
+        return memcmp(a, b, fixed) == 0; \
     }
 
 #elif defined(CREATE_HASH_FUNCTIONS)
 #undef CREATE_HASH_FUNCTIONS
+// hashes the fixed-layout block at once, see above
 #define START(funcname, structname) \
-    static unsigned funcname##_hash(void *buf, size_t len) \
+    static inline uint64_t funcname##_hash(void *buf, size_t len) \
     { \
         struct structname *p = buf; \
-        unsigned hval = FNV1_32A_INIT;
+        uint64_t hval = ASS_HASH_INIT; \
+        size_t fixed = 0;
 #define GENERIC(type, member) \
-        hval = fnv_32a_buf(&p->member, sizeof(p->member), hval);
+        fixed = (char *) &p->member - (char *) p + sizeof(p->member);
 #define STRING(member) \
-        hval = fnv_32a_str(p->member, hval);
-#define FTVECTOR(member) GENERIC(, member.x); GENERIC(, member.y);
-#define BITMAPHASHKEY(member) { \
-        unsigned temp = bitmap_hash(&p->member, sizeof(p->member)); \
-        hval = fnv_32a_buf(&temp, sizeof(temp), hval); \
-        }
+        hval = ass_hash_buf(p, fixed, hval); \
+        hval = ass_hash_str(p->member, hval); \
+        fixed = 0;
+#define FTVECTOR(member) GENERIC(FT_Vector, member)
+#define BITMAPHASHKEY(member) \
+        hval = ass_hash_buf(p, fixed, hval); \
+        hval = ass_hash_mix(hval, bitmap_hash(&p->member, sizeof(p->member))); \
+        fixed = 0;
 #define END(typedefname) \
-        return hval; \
+        return ass_hash_buf(p, fixed, hval); \
     }
 
 #else
@@ -108,6 +121,15 @@ START(glyph_metrics, glyph_metrics_hash_key)
     GENERIC(unsigned, scale_y)
 END(GlyphMetricsHashKey)
 
+// describes a kerning pair of one face at one size
+START(kerning, kerning_hash_key)
+    GENERIC(ASS_Font *, font)
+    GENERIC(double, size)
+    GENERIC(int, face_index)
+    GENERIC(unsigned, first)    // glyph indices
+    GENERIC(unsigned, second)
+END(KerningHashKey)
+
 // describes an outline drawing
 START(drawing, drawing_hash_key)
     GENERIC(unsigned, scale_x)
@@ -117,7 +139,7 @@ START(drawing, drawing_hash_key)
     GENERIC(unsigned, border_style)
     GENERIC(int, hspacing)
     GENERIC(int, scale)
-    GENERIC(unsigned, hash)
+    GENERIC(uint64_t, hash)
     STRING(text)
 END(DrawingHashKey)
 
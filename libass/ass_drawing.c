@@ -383,11 +383,10 @@ void ass_drawing_add_char(ASS_Drawing* drawing, char symbol)
 
 /*
  * \brief Create a hashcode for the drawing
- * XXX: To avoid collisions a better hash algorithm might be useful.
  */
 void ass_drawing_hash(ASS_Drawing* drawing)
 {
-    drawing->hash = fnv_32a_str(drawing->text, FNV1_32A_INIT);
+    drawing->hash = ass_hash_str(drawing->text, ASS_HASH_INIT);
 }
 
 /*
@@ -19,6 +19,7 @@
 #ifndef LIBASS_DRAWING_H
 #define LIBASS_DRAWING_H
 
+#include <stdint.h>
 #include <ft2build.h>
 #include FT_OUTLINE_H
 
@@ -55,7 +56,7 @@ typedef struct {
     int desc;           // descender
     FT_Outline outline; // target outline
     FT_Vector advance;  // advance (from cbox)
-    int hash;           // hash value (for caching)
+    uint64_t hash;      // hash value (for caching)
 
     // private
     FT_Library ftlibrary;   // needed for font ops
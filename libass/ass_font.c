@@ -92,18 +92,6 @@ uint32_t ass_font_index_magic(FT_Face face, uint32_t symbol)
     }
 }
 
-/**
- * \brief find a memory font by name
- */
-static int find_font(ASS_Library *library, char *name)
-{
-    int i;
-    for (i = 0; i < library->num_fontdata; ++i)
-        if (strcasecmp(name, library->fontdata[i].name) == 0)
-            return i;
-    return -1;
-}
-
 static void buggy_font_workaround(FT_Face face)
 {
     // Some fonts have zero Ascender/Descender fields in 'hhea' table.
@@ -145,7 +133,7 @@ static int add_face(void *fc_priv, ASS_Font *font, uint32_t ch)
     if (!path)
         return -1;
 
-    mem_idx = find_font(font->library, path);
+    mem_idx = ass_library_find_font(font->library, path);
     if (mem_idx >= 0) {
         error =
             FT_New_Memory_Face(font->ftlibrary,
@@ -177,6 +165,42 @@ static int add_face(void *fc_priv, ASS_Font *font, uint32_t ch)
     return font->n_faces - 1;
 }
 
+/**
+ * \brief Fill in a font description from style or override tag values
+ * \param family font name, a leading '@' selects vertical layout;
+ * desc->family points into this string
+ * \param bold 0 = normal, 1 = bold, >1 = exact weight
+ * \param italic 0 = normal, 1 = italic
+ */
+void ass_font_desc_init(ASS_FontDesc *desc, char *family, int bold,
+                        int italic, int treat_family_as_pattern)
+{
+    unsigned val;
+    desc->treat_family_as_pattern = treat_family_as_pattern;
+
+    if (family[0] == '@') {
+        desc->vertical = 1;
+        desc->family = family + 1;
+    } else {
+        desc->vertical = 0;
+        desc->family = family;
+    }
+
+    val = bold;
+    if (val == 1)
+        val = 200;              // bold
+    else if (val <= 0)
+        val = 80;               // normal
+    desc->bold = val;
+
+    val = italic;
+    if (val == 1)
+        val = 110;              // italic
+    else if (val <= 0)
+        val = 0;                // normal
+    desc->italic = val;
+}
+
 /**
  * \brief Create a new ASS_Font according to "desc" argument
  */
@@ -188,7 +212,7 @@ ASS_Font *ass_font_new(Cache *font_cache, ASS_Library *library,
     ASS_Font *fontp;
     ASS_Font font;
 
-    fontp = ass_cache_get(font_cache, desc);
+    fontp = ass_font_cache_get(font_cache, desc);
     if (fontp)
         return fontp;
 
@@ -205,13 +229,16 @@ ASS_Font *ass_font_new(Cache *font_cache, ASS_Library *library,
     font.scale_x = font.scale_y = 1.;
     font.v.x = font.v.y = 0;
     font.size = 0.;
+    font.refs = 0;
+    font.last_used = 0;
+    font.evicted = 0;
 
     error = add_face(fc_priv, &font, 0);
     if (error == -1) {
         free(font.desc.family);
         return 0;
     } else
-        return ass_cache_put(font_cache, &font.desc, &font);
+        return ass_font_cache_put(font_cache, &font.desc, &font);
 }
 
 /**
@@ -580,10 +607,45 @@ FT_Glyph ass_font_get_glyph(void *fontconfig_priv, ASS_Font *font,
     return glyph;
 }
 
+/**
+ * \brief Get kerning for a pair of glyph indices of one face, through the
+ * kerning cache.  Pairs without kerning are cached as well, since those
+ * are the common case.
+ * \param kerning_cache kerning cache
+ * \param size font size the face is currently set to
+ **/
+FT_Vector ass_font_get_kerning_pair(Cache *kerning_cache, ASS_Font *font,
+                                    int face_index, double size,
+                                    unsigned first, unsigned second)
+{
+    FT_Face face = font->faces[face_index];
+    KerningHashKey key;
+    KerningHashValue *val, new_val;
+
+    memset(&key, 0, sizeof(key));
+    key.font = font;
+    key.size = size;
+    key.face_index = face_index;
+    key.first = first;
+    key.second = second;
+    val = ass_kerning_cache_get(kerning_cache, &key);
+    if (val)
+        return val->kern;
+
+    new_val.kern.x = new_val.kern.y = 0;
+    if (FT_HAS_KERNING(face) &&
+        FT_Get_Kerning(face, first, second, FT_KERNING_DEFAULT,
+                       &new_val.kern))
+        new_val.kern.x = new_val.kern.y = 0;
+    ass_kerning_cache_put(kerning_cache, &key, &new_val);
+    return new_val.kern;
+}
+
 /**
  * \brief Get kerning for the pair of glyphs.
  **/
-FT_Vector ass_font_get_kerning(ASS_Font *font, uint32_t c1, uint32_t c2)
+FT_Vector ass_font_get_kerning(Cache *kerning_cache, ASS_Font *font,
+                               double size, uint32_t c1, uint32_t c2)
 {
     FT_Vector v = { 0, 0 };
     int i;
@@ -595,11 +657,9 @@ FT_Vector ass_font_get_kerning(ASS_Font *font, uint32_t c1, uint32_t c2)
         FT_Face face = font->faces[i];
         int i1 = FT_Get_Char_Index(face, ass_font_index_magic(face, c1));
         int i2 = FT_Get_Char_Index(face, ass_font_index_magic(face, c2));
-        if (i1 && i2) {
-            if (FT_HAS_KERNING(face))
-                FT_Get_Kerning(face, i1, i2, FT_KERNING_DEFAULT, &v);
-            return v;
-        }
+        if (i1 && i2)
+            return ass_font_get_kerning_pair(kerning_cache, font, i, size,
+                                             i1, i2);
         if (i1 || i2)           // these glyphs are from different font faces, no kerning information
             return v;
     }
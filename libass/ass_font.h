@@ -53,10 +53,15 @@ typedef struct {
     double scale_x, scale_y;    // current transform
     FT_Vector v;                // current shift
     double size;
+    int refs;                   // glyph cache entries keyed on this font
+    unsigned last_used;         // last frame that selected this font
+    int evicted;                // being removed from the font cache
 } ASS_Font;
 
 #include "ass_cache.h"
 
+void ass_font_desc_init(ASS_FontDesc *desc, char *family, int bold,
+                        int italic, int treat_family_as_pattern);
 ASS_Font *ass_font_new(Cache *font_cache, ASS_Library *library,
                        FT_Library ftlibrary, void *fc_priv,
                        ASS_FontDesc *desc);
@@ -72,7 +77,11 @@ uint32_t ass_font_index_magic(FT_Face face, uint32_t symbol);
 FT_Glyph ass_font_get_glyph(void *fontconfig_priv, ASS_Font *font,
                             uint32_t ch, int face_index, int index,
                             ASS_Hinting hinting, int deco);
-FT_Vector ass_font_get_kerning(ASS_Font *font, uint32_t c1, uint32_t c2);
+FT_Vector ass_font_get_kerning_pair(Cache *kerning_cache, ASS_Font *font,
+                                    int face_index, double size,
+                                    unsigned first, unsigned second);
+FT_Vector ass_font_get_kerning(Cache *kerning_cache, ASS_Font *font,
+                               double size, uint32_t c1, uint32_t c2);
 void ass_font_free(ASS_Font *font);
 void fix_freetype_stroker(FT_Outline *outline, int border_x, int border_y);
 void outline_copy(FT_Library lib, FT_Outline *source, FT_Outline **dest);
@@ -22,7 +22,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdarg.h>
+#include <ctype.h>
 
 #include "ass.h"
 #include "ass_library.h"
@@ -41,6 +43,9 @@ ASS_Library *ass_library_init(void)
 {
     ASS_Library* lib = calloc(1, sizeof(*lib));
     lib->msg_callback = ass_msg_handler;
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_init(&lib->font_lock, NULL);
+#endif
 
     return lib;
 }
@@ -51,6 +56,9 @@ void ass_library_done(ASS_Library *priv)
         ass_set_fonts_dir(priv, NULL);
         ass_set_style_overrides(priv, NULL);
         ass_clear_fonts(priv);
+#ifdef CONFIG_PTHREAD
+        pthread_mutex_destroy(&priv->font_lock);
+#endif
         free(priv);
     }
 }
@@ -67,6 +75,16 @@ void ass_set_extract_fonts(ASS_Library *priv, int extract)
     priv->extract_fonts = !!extract;
 }
 
+void ass_set_predecode_text(ASS_Library *priv, int predecode)
+{
+    priv->predecode_text = !!predecode;
+}
+
+void ass_set_pool_strings(ASS_Library *priv, int pool)
+{
+    priv->pool_strings = !!pool;
+}
+
 void ass_set_style_overrides(ASS_Library *priv, char **list)
 {
     char **p;
@@ -98,10 +116,85 @@ static void grow_array(void **array, int nelem, size_t elsize)
         *array = realloc(*array, (nelem + 32) * elsize);
 }
 
-void ass_add_font(ASS_Library *priv, char *name, char *data, int size)
+#define FONTDATA_INDEX_MIN 64
+
+// case-insensitive, to match the strcasecmp lookup
+static uint64_t fontname_hash(const char *name)
+{
+    uint64_t hval = ASS_HASH_INIT;
+    for (; *name; name++)
+        hval = ass_hash_mix(hval, tolower((unsigned char) *name));
+    return ass_hash_final(hval);
+}
+
+/**
+ * \brief Add a fontdata entry to the name index.  An existing entry with
+ * the same name is kept, so lookups find the first font added.
+ */
+static void index_fontdata(ASS_Library *priv, int idx)
+{
+    unsigned mask = priv->fontdata_index_size - 1;
+    unsigned slot = fontname_hash(priv->fontdata[idx].name) & mask;
+
+    while (priv->fontdata_index[slot]) {
+        int other = priv->fontdata_index[slot] - 1;
+        if (!strcasecmp(priv->fontdata[other].name, priv->fontdata[idx].name))
+            return;
+        slot = (slot + 1) & mask;
+    }
+    priv->fontdata_index[slot] = idx + 1;
+}
+
+/**
+ * \brief Make room for one more font in the name index, keeping the load
+ * factor at or below 1/2
+ */
+static int grow_fontdata_index(ASS_Library *priv)
+{
+    int *index;
+    int i, size = priv->fontdata_index_size;
+
+    if ((priv->num_fontdata + 1) * 2 <= size)
+        return 1;
+
+    size = size ? size * 2 : FONTDATA_INDEX_MIN;
+    index = calloc(size, sizeof(*index));
+    if (!index)
+        return 0;
+    free(priv->fontdata_index);
+    priv->fontdata_index = index;
+    priv->fontdata_index_size = size;
+    for (i = 0; i < priv->num_fontdata; ++i)
+        index_fontdata(priv, i);
+    return 1;
+}
+
+/**
+ * \brief Find a memory font by name, ignoring case
+ * \return index into priv->fontdata, or -1 if there is no such font
+ */
+int ass_library_find_font(ASS_Library *priv, const char *name)
+{
+    unsigned mask, slot;
+
+    if (!priv->fontdata_index_size)
+        return -1;
+
+    mask = priv->fontdata_index_size - 1;
+    slot = fontname_hash(name) & mask;
+    while (priv->fontdata_index[slot]) {
+        int idx = priv->fontdata_index[slot] - 1;
+        if (!strcasecmp(priv->fontdata[idx].name, name))
+            return idx;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+static void add_fontdata(ASS_Library *priv, char *name, char *data, int size)
 {
     int idx = priv->num_fontdata;
-    if (!name || !data || !size)
+    if (!grow_fontdata_index(priv))
         return;
     grow_array((void **) &priv->fontdata, priv->num_fontdata,
                sizeof(*priv->fontdata));
@@ -114,11 +207,28 @@ void ass_add_font(ASS_Library *priv, char *name, char *data, int size)
     priv->fontdata[idx].size = size;
 
     priv->num_fontdata++;
+    index_fontdata(priv, idx);
+}
+
+void ass_add_font(ASS_Library *priv, char *name, char *data, int size)
+{
+    if (!name || !data || !size)
+        return;
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_lock(&priv->font_lock);
+#endif
+    add_fontdata(priv, name, data, size);
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_unlock(&priv->font_lock);
+#endif
 }
 
 void ass_clear_fonts(ASS_Library *priv)
 {
     int i;
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_lock(&priv->font_lock);
+#endif
     for (i = 0; i < priv->num_fontdata; ++i) {
         free(priv->fontdata[i].name);
         free(priv->fontdata[i].data);
@@ -126,6 +236,12 @@ void ass_clear_fonts(ASS_Library *priv)
     free(priv->fontdata);
     priv->fontdata = NULL;
     priv->num_fontdata = 0;
+    free(priv->fontdata_index);
+    priv->fontdata_index = NULL;
+    priv->fontdata_index_size = 0;
+#ifdef CONFIG_PTHREAD
+    pthread_mutex_unlock(&priv->font_lock);
+#endif
 }
 
 /*
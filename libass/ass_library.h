@@ -20,6 +20,9 @@
 #define LIBASS_LIBRARY_H
 
 #include <stdarg.h>
+#ifdef CONFIG_PTHREAD
+#include <pthread.h>
+#endif
 
 typedef struct {
     char *name;
@@ -30,12 +33,24 @@ typedef struct {
 struct ass_library {
     char *fonts_dir;
     int extract_fonts;
+    int predecode_text;
+    int pool_strings;
     char **style_overrides;
 
     ASS_Fontdata *fontdata;
     int num_fontdata;
+    // open-addressing index of fontdata by case-folded name; holds
+    // fontdata index + 1, 0 marks an empty slot
+    int *fontdata_index;
+    int fontdata_index_size;    // power of two, or 0 if not allocated
+#ifdef CONFIG_PTHREAD
+    // guards fontdata against font prefetch threads, which read it
+    pthread_mutex_t font_lock;
+#endif
     void (*msg_callback)(int, const char *, va_list, void *);
     void *msg_callback_data;
 };
 
+int ass_library_find_font(struct ass_library *priv, const char *name);
+
 #endif                          /* LIBASS_LIBRARY_H */
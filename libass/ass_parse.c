@@ -27,7 +27,6 @@
 #include "ass_parse.h"
 
 #define MAX_BE 127
-#define NBSP 0xa0   // unicode non-breaking space character
 
 #define skip_to(x) while ((*p != (x)) && (*p != '}') && (*p != 0)) { ++p;}
 #define skip(x) if (*p == (x)) ++p; else { return p; }
@@ -67,41 +66,20 @@ static void change_font_size(ASS_Renderer *render_priv, double sz)
  */
 void update_font(ASS_Renderer *render_priv)
 {
-    unsigned val;
     ASS_FontDesc desc;
-    desc.treat_family_as_pattern = render_priv->state.treat_family_as_pattern;
-
-    if (render_priv->state.family[0] == '@') {
-        desc.vertical = 1;
-        desc.family = strdup(render_priv->state.family + 1);
-    } else {
-        desc.vertical = 0;
-        desc.family = strdup(render_priv->state.family);
-    }
-
-    val = render_priv->state.bold;
-    // 0 = normal, 1 = bold, >1 = exact weight
-    if (val == 1)
-        val = 200;              // bold
-    else if (val <= 0)
-        val = 80;               // normal
-    desc.bold = val;
-
-    val = render_priv->state.italic;
-    if (val == 1)
-        val = 110;              // italic
-    else if (val <= 0)
-        val = 0;                // normal
-    desc.italic = val;
 
+    ass_font_desc_init(&desc, render_priv->state.family,
+                       render_priv->state.bold, render_priv->state.italic,
+                       render_priv->state.treat_family_as_pattern);
     render_priv->state.font =
         ass_font_new(render_priv->cache.font_cache, render_priv->library,
                      render_priv->ftlibrary, render_priv->fontconfig_priv,
                      &desc);
-    free(desc.family);
 
-    if (render_priv->state.font)
+    if (render_priv->state.font) {
+        render_priv->state.font->last_used = render_priv->cache.frames;
         change_font_size(render_priv, render_priv->state.font_size);
+    }
 }
 
 /**
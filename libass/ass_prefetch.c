@@ -0,0 +1,569 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Font prefetch.  ass_prefetch_fonts scans a track for the fonts its
+ * events select, through styles and \fn, \b, \i and \r tags, and for the
+ * characters drawn with each of them.  A background thread then loads the
+ * fonts into the renderer's font cache and looks up every character, so
+ * the fallback faces needed for them are added as well.
+ *
+ * The font cache, fontconfig and FreeType are not thread-safe, so the
+ * prefetch thread only uses them while it holds the renderer's fonts,
+ * a few characters at a time.  Rendering holds the fonts for the whole
+ * frame and takes precedence: the thread does not pick them up again
+ * while a frame is waiting for them.  The memory fonts of the library may
+ * change at any time, so the thread also holds the library's font lock
+ * while it loads fonts.
+ *
+ * Prefetching stops once the font cache reaches its limit, since the
+ * next frame would start evicting fonts, the prefetched ones first.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef CONFIG_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "ass.h"
+#include "ass_render.h"
+#include "ass_prefetch.h"
+
+#define PREFETCH_CHUNK 32       // characters looked up at a time
+
+typedef struct {
+    ASS_FontDesc desc;          // the item owns desc.family
+    uint32_t ascii[4];          // ASCII characters already in chars
+    uint32_t *chars;            // sorted and unique once the scan is done
+    int n_chars;
+    int max_chars;
+} PrefetchItem;
+
+typedef struct {
+    PrefetchItem *items;
+    int n_items;
+    int max_items;
+} PrefetchList;
+
+typedef struct {
+    PrefetchList *list;
+    ASS_Style *style;           // event style, for tags without a value
+    char *family;               // points to a style's name or to fn_buf
+    char *fn_buf;               // family of the last \fn tag
+    int bold;
+    int italic;
+    int treat_family_as_pattern;
+    int drawing;
+    int item;                   // index of the current font, -1 if unknown
+} ScanState;
+
+static void free_item(PrefetchItem *item)
+{
+    free(item->desc.family);
+    free(item->chars);
+}
+
+static void free_list(PrefetchList *list, int first)
+{
+    int i;
+    for (i = first; i < list->n_items; ++i)
+        free_item(list->items + i);
+    free(list->items);
+    list->items = NULL;
+    list->n_items = list->max_items = 0;
+}
+
+/**
+ * \brief Find or add the list item for a font description
+ * \return item index, -1 on allocation failure
+ */
+static int get_item(PrefetchList *list, ASS_FontDesc *desc)
+{
+    PrefetchItem *item;
+    int i;
+
+    for (i = 0; i < list->n_items; ++i) {
+        item = list->items + i;
+        if (item->desc.bold == desc->bold &&
+            item->desc.italic == desc->italic &&
+            item->desc.vertical == desc->vertical &&
+            item->desc.treat_family_as_pattern ==
+            desc->treat_family_as_pattern &&
+            !strcmp(item->desc.family, desc->family))
+            return i;
+    }
+
+    if (list->n_items == list->max_items) {
+        int max = list->max_items ? 2 * list->max_items : 16;
+        item = realloc(list->items, max * sizeof(*item));
+        if (!item)
+            return -1;
+        list->items = item;
+        list->max_items = max;
+    }
+    item = list->items + list->n_items;
+    memset(item, 0, sizeof(*item));
+    item->desc = *desc;
+    item->desc.family = strdup(desc->family);
+    if (!item->desc.family)
+        return -1;
+    return list->n_items++;
+}
+
+static void add_char(PrefetchItem *item, uint32_t ch)
+{
+    // see ass_font_get_index
+    if (ch < 0x20)
+        return;
+    if (ch == 0xa0)
+        ch = ' ';
+
+    if (ch < 128) {
+        if (item->ascii[ch >> 5] & (1u << (ch & 31)))
+            return;
+        item->ascii[ch >> 5] |= 1u << (ch & 31);
+    } else if (item->n_chars && item->chars[item->n_chars - 1] == ch)
+        return;
+
+    if (item->n_chars == item->max_chars) {
+        int max = item->max_chars ? 2 * item->max_chars : 64;
+        uint32_t *chars = realloc(item->chars, max * sizeof(*chars));
+        if (!chars)
+            return;
+        item->chars = chars;
+        item->max_chars = max;
+    }
+    item->chars[item->n_chars++] = ch;
+}
+
+static int cmp_char(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void finish_item(PrefetchItem *item)
+{
+    int i, n = 0;
+    qsort(item->chars, item->n_chars, sizeof(*item->chars), cmp_char);
+    for (i = 0; i < item->n_chars; ++i)
+        if (!n || item->chars[n - 1] != item->chars[i])
+            item->chars[n++] = item->chars[i];
+    item->n_chars = n;
+}
+
+static void reset_scan(ScanState *s, ASS_Style *style)
+{
+    s->family = style->FontName;
+    s->bold = style->Bold;
+    s->italic = style->Italic;
+    s->treat_family_as_pattern = style->treat_fontname_as_pattern;
+    s->item = -1;
+}
+
+static void scan_char(ScanState *s, uint32_t ch)
+{
+    if (s->drawing || !s->family)
+        return;
+    if (s->item < 0) {
+        ASS_FontDesc desc;
+        ass_font_desc_init(&desc, s->family, s->bold, s->italic,
+                           s->treat_family_as_pattern);
+        s->item = get_item(s->list, &desc);
+        if (s->item < 0)
+            return;
+    }
+    add_char(s->list->items + s->item, ch);
+}
+
+/**
+ * \brief Follow the tags of an override block that change the font, like
+ * parse_tag does
+ * \return pointer to the end of the block
+ */
+static char *scan_tags(ASS_Track *track, ScanState *s, char *p)
+{
+    while (*p && *p != '}') {
+        char *end;
+        int val;
+
+        if (*p++ != '\\')
+            continue;
+        end = p;
+        while (*end && *end != '\\' && *end != '}')
+            ++end;
+
+        if (!strncmp(p, "fn", 2)) {
+            p += 2;
+            free(s->fn_buf);
+            s->fn_buf = NULL;
+            if (end > p && strncmp(p, "0", end - p)) {
+                s->fn_buf = malloc(end - p + 1);
+                if (s->fn_buf) {
+                    memcpy(s->fn_buf, p, end - p);
+                    s->fn_buf[end - p] = '\0';
+                }
+                s->family = s->fn_buf;
+            } else
+                s->family = s->style->FontName;
+            s->item = -1;
+        } else if (*p == 'r') {
+            ASS_Style *style = s->style;
+            int i;
+            ++p;
+            for (i = track->n_styles - 1; i >= 0 && end > p; --i)
+                if (strlen(track->styles[i].Name) == end - p &&
+                    !strncmp(track->styles[i].Name, p, end - p)) {
+                    style = track->styles + i;
+                    break;
+                }
+            reset_scan(s, style);
+        } else if (*p == 'b' && strncmp(p, "blur", 4) &&
+                   strncmp(p, "bord", 4) && strncmp(p, "be", 2)) {
+            ++p;
+            if (!mystrtoi(&p, &val) || !(val == 0 || val == 1 || val >= 100))
+                val = s->style->Bold;
+            s->bold = val;
+            s->item = -1;
+        } else if (*p == 'i' && strncmp(p, "iclip", 5)) {
+            ++p;
+            if (!mystrtoi(&p, &val) || !(val == 0 || val == 1))
+                val = s->style->Italic;
+            s->italic = val;
+            s->item = -1;
+        } else if (*p == 'p' && strncmp(p, "pbo", 3) &&
+                   strncmp(p, "pos", 3)) {
+            ++p;
+            s->drawing = mystrtoi(&p, &val) && val > 0;
+        }
+        p = end;
+    }
+    return p;
+}
+
+/**
+ * \brief Collect the fonts and characters of an event, like
+ * ass_render_event and get_next_char would select them
+ */
+static void scan_event(ASS_Track *track, ScanState *s, ASS_Event *event)
+{
+    char *p = event->Text;
+
+    s->style = track->styles + event->Style;
+    s->drawing = 0;
+    reset_scan(s, s->style);
+
+    while (*p) {
+        uint32_t ch;
+        if (*p == '{') {
+            p = scan_tags(track, s, p + 1);
+            if (*p == '}')
+                ++p;
+            continue;
+        }
+        if (*p == '\t') {
+            ch = ' ';
+            ++p;
+        } else if (*p == '\\' && (p[1] == 'N' || p[1] == 'n')) {
+            p += 2;
+            continue;
+        } else if (*p == '\\' && (p[1] == 'h' || p[1] == '{' ||
+                                  p[1] == '}')) {
+            ch = p[1] == 'h' ? ' ' : (uint32_t) p[1];
+            p += 2;
+        } else
+            ch = ass_utf8_get_char(&p);
+        scan_char(s, ch);
+    }
+}
+
+static void scan_track(ASS_Track *track, PrefetchList *list)
+{
+    ScanState s;
+    int i;
+
+    memset(&s, 0, sizeof(s));
+    s.list = list;
+    for (i = 0; i < track->n_events; ++i) {
+        ASS_Event *event = track->events + i;
+        if (event->Text && event->Style >= 0 &&
+            event->Style < track->n_styles)
+            scan_event(track, &s, event);
+    }
+    free(s.fn_buf);
+
+    for (i = 0; i < list->n_items; ++i)
+        finish_item(list->items + i);
+}
+
+/**
+ * \brief Check whether loading a font would take the font cache over its
+ * limit, so that the next frame evicts fonts
+ */
+static int font_cache_full(ASS_Renderer *priv, ASS_FontDesc *desc)
+{
+    ASS_CacheStats stats;
+
+    ass_cache_stats(priv->cache.font_cache, &stats);
+    return stats.size >= priv->cache.font_max &&
+           !ass_cache_contains(priv->cache.font_cache, desc);
+}
+
+/**
+ * \brief Load the font of an item and look up some of its characters.
+ * Caller must hold the renderer's fonts.
+ * \param pos first character to look up
+ * \return position of the next character, -1 when the item is done, -2
+ * when the font cache is full and prefetching should stop
+ */
+static int resolve_item(ASS_Renderer *priv, PrefetchItem *item, int pos)
+{
+    ASS_Font *font;
+    int end = FFMIN(pos + PREFETCH_CHUNK, item->n_chars);
+
+    // the font cache may have been emptied since the last call, so look
+    // up the font every time; that is a cache hit almost always
+    if (font_cache_full(priv, &item->desc))
+        return -2;
+    font = ass_font_new(priv->cache.font_cache, priv->library,
+                        priv->ftlibrary, priv->fontconfig_priv, &item->desc);
+    if (!font)
+        return -1;
+    for (; pos < end; ++pos) {
+        int face_index = 0, glyph_index;
+        ass_font_get_index(priv->fontconfig_priv, font, item->chars[pos],
+                           &face_index, &glyph_index);
+    }
+    return pos < item->n_chars ? pos : -1;
+}
+
+#ifdef CONFIG_PTHREAD
+struct ass_prefetch {
+    ASS_Renderer *renderer;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        // signalled when the fonts are released
+    pthread_t thread;
+    int thread_started;         // thread has to be joined
+    int running;                // thread is working on the queue
+    int cancel;
+    int busy;                   // fonts are in use
+    int waiting;                // frames waiting for the fonts
+
+    PrefetchList queue;
+    int next;                   // next item of the queue to resolve
+};
+
+/**
+ * \brief Wait for the fonts and take them.  Must be called with the lock
+ * held; returns with the lock held.
+ */
+static void acquire_fonts(ASS_Prefetch *pf, int render)
+{
+    pf->waiting += render;
+    while (pf->busy || (!render && pf->waiting))
+        pthread_cond_wait(&pf->cond, &pf->lock);
+    pf->waiting -= render;
+    pf->busy = 1;
+}
+
+static void release_fonts(ASS_Prefetch *pf)
+{
+    pf->busy = 0;
+    pthread_cond_broadcast(&pf->cond);
+}
+
+static void *prefetch_thread(void *arg)
+{
+    ASS_Prefetch *pf = arg;
+    ASS_Library *library = pf->renderer->library;
+    PrefetchItem item;
+    int pos = -1;
+
+    pthread_mutex_lock(&pf->lock);
+    while (!pf->cancel) {
+        if (pos < 0) {
+            if (pf->next == pf->queue.n_items)
+                break;
+            item = pf->queue.items[pf->next++];
+            pos = 0;
+        }
+        acquire_fonts(pf, 0);
+        if (!pf->cancel) {
+            pthread_mutex_unlock(&pf->lock);
+            pthread_mutex_lock(&library->font_lock);
+            pos = resolve_item(pf->renderer, &item, pos);
+            pthread_mutex_unlock(&library->font_lock);
+            pthread_mutex_lock(&pf->lock);
+        }
+        release_fonts(pf);
+        if (pos < 0)
+            free_item(&item);
+        if (pos == -2)
+            break;
+    }
+    if (pos >= 0)
+        free_item(&item);
+
+    // also drops whatever is left when the font cache is full
+    free_list(&pf->queue, pf->next);
+    pf->next = 0;
+    pf->running = 0;
+    pthread_mutex_unlock(&pf->lock);
+    return NULL;
+}
+
+/**
+ * \brief Move the items of src to the end of dst
+ * \return 0 on allocation failure, src is left unchanged then
+ */
+static int append_list(PrefetchList *dst, PrefetchList *src)
+{
+    if (dst->n_items + src->n_items > dst->max_items) {
+        int max = dst->n_items + src->n_items;
+        PrefetchItem *items = realloc(dst->items, max * sizeof(*items));
+        if (!items)
+            return 0;
+        dst->items = items;
+        dst->max_items = max;
+    }
+    memcpy(dst->items + dst->n_items, src->items,
+           src->n_items * sizeof(*src->items));
+    dst->n_items += src->n_items;
+    free(src->items);
+    src->items = NULL;
+    src->n_items = src->max_items = 0;
+    return 1;
+}
+
+static ASS_Prefetch *prefetch_new(ASS_Renderer *priv)
+{
+    ASS_Prefetch *pf = calloc(1, sizeof(*pf));
+    if (!pf)
+        return NULL;
+    pf->renderer = priv;
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->cond, NULL);
+    return pf;
+}
+
+/**
+ * \brief Hand a list over to the prefetch thread, starting it if needed
+ * \return 0 if the list could not be queued
+ */
+static int queue_list(ASS_Renderer *priv, PrefetchList *list)
+{
+    ASS_Prefetch *pf = priv->prefetch;
+    int ok;
+
+    if (!pf)
+        pf = priv->prefetch = prefetch_new(priv);
+    if (!pf)
+        return 0;
+
+    pthread_mutex_lock(&pf->lock);
+    ok = append_list(&pf->queue, list);
+    if (ok && !pf->running) {
+        if (pf->thread_started)
+            pthread_join(pf->thread, NULL);
+        pf->thread_started =
+            !pthread_create(&pf->thread, NULL, prefetch_thread, pf);
+        pf->running = pf->thread_started;
+        if (!pf->running) {
+            // the caller resolves the fonts itself
+            *list = pf->queue;
+            memset(&pf->queue, 0, sizeof(pf->queue));
+            pf->next = 0;
+            ok = 0;
+        }
+    }
+    pthread_mutex_unlock(&pf->lock);
+    return ok;
+}
+
+void ass_prefetch_lock(ASS_Prefetch *pf)
+{
+    if (!pf)
+        return;
+    pthread_mutex_lock(&pf->lock);
+    acquire_fonts(pf, 1);
+    pthread_mutex_unlock(&pf->lock);
+}
+
+void ass_prefetch_unlock(ASS_Prefetch *pf)
+{
+    if (!pf)
+        return;
+    pthread_mutex_lock(&pf->lock);
+    release_fonts(pf);
+    pthread_mutex_unlock(&pf->lock);
+}
+
+void ass_prefetch_free(ASS_Prefetch *pf)
+{
+    if (!pf)
+        return;
+    pthread_mutex_lock(&pf->lock);
+    pf->cancel = 1;
+    pthread_mutex_unlock(&pf->lock);
+    if (pf->thread_started)
+        pthread_join(pf->thread, NULL);
+    free_list(&pf->queue, pf->next);
+    pthread_cond_destroy(&pf->cond);
+    pthread_mutex_destroy(&pf->lock);
+    free(pf);
+}
+#else
+static int queue_list(ASS_Renderer *priv, PrefetchList *list)
+{
+    return 0;
+}
+
+void ass_prefetch_lock(ASS_Prefetch *pf)
+{
+}
+
+void ass_prefetch_unlock(ASS_Prefetch *pf)
+{
+}
+
+void ass_prefetch_free(ASS_Prefetch *pf)
+{
+}
+#endif
+
+void ass_prefetch_fonts(ASS_Renderer *priv, ASS_Track *track)
+{
+    PrefetchList list;
+    int i;
+
+    memset(&list, 0, sizeof(list));
+    scan_track(track, &list);
+    if (!list.n_items || queue_list(priv, &list))
+        return;
+
+    // no thread, resolve everything now
+    for (i = 0; i < list.n_items; ++i) {
+        int pos = 0;
+        while (pos >= 0)
+            pos = resolve_item(priv, list.items + i, pos);
+        if (pos == -2)
+            break;
+    }
+    free_list(&list, 0);
+}
@@ -0,0 +1,418 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Pre-rendered subtitle files.
+ *
+ * Layout (native byte order, checked with the byte order mark):
+ *   PrerenderHeader
+ *   for every interval: bitmaps (stride == w), then PrerenderImage records
+ *   PrerenderInterval index, sorted by start time
+ *
+ * The reader only needs libc, so it works without running any part of
+ * the shaping and rasterization pipeline.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ass.h"
+#include "ass_render.h"
+
+#define PRERENDER_MAGIC "ASSPRERD"
+#define PRERENDER_VERSION 1
+#define PRERENDER_BOM 0x01020304
+
+typedef struct {
+    char magic[8];
+    uint32_t bom;
+    uint32_t version;
+    int32_t frame_w, frame_h;
+    uint32_t n_intervals;
+    uint32_t reserved;
+    uint64_t index_offset;
+} PrerenderHeader;
+
+typedef struct {
+    int64_t start, end;         // visible in [start, end)
+    uint32_t n_images;
+    uint32_t reserved;
+    uint64_t images_offset;     // PrerenderImage records
+} PrerenderInterval;
+
+typedef struct {
+    int32_t w, h;
+    int32_t dst_x, dst_y;
+    uint32_t color;
+    uint32_t type;
+    uint64_t bitmap_offset;
+} PrerenderImage;
+
+struct ass_prerendered {
+    unsigned char *data;
+    size_t size;
+    int mapped;
+    PrerenderHeader *header;
+    PrerenderInterval *index;
+    ASS_Image *images;          // returned image list
+    int max_images;
+};
+
+typedef struct {
+    FILE *fp;
+    uint64_t pos;
+    PrerenderInterval *index;
+    int n_intervals;
+    int max_intervals;
+} PrerenderWriter;
+
+static int write_data(PrerenderWriter *w, const void *data, size_t size)
+{
+    if (size && fwrite(data, size, 1, w->fp) != 1)
+        return 0;
+    w->pos += size;
+    return 1;
+}
+
+// keep records 8-byte aligned so the reader can use them in place
+static int write_padding(PrerenderWriter *w)
+{
+    static const char zero[8];
+    return write_data(w, zero, -w->pos & 7);
+}
+
+/**
+ * \brief Append an interval with the given image list.
+ */
+static int write_interval(PrerenderWriter *w, ASS_Image *img,
+                          long long start)
+{
+    PrerenderInterval *iv;
+    PrerenderImage rec;
+    ASS_Image *cur;
+    uint64_t bitmaps = w->pos;
+    uint64_t offset;
+    int n = 0;
+
+    if (w->n_intervals >= w->max_intervals) {
+        int max_intervals = w->max_intervals ? w->max_intervals * 2 : 64;
+        PrerenderInterval *index =
+            realloc(w->index, max_intervals * sizeof(PrerenderInterval));
+        if (!index)
+            return 0;
+        w->index = index;
+        w->max_intervals = max_intervals;
+    }
+
+    for (cur = img; cur; cur = cur->next) {
+        int y;
+        if (cur->w <= 0 || cur->h <= 0)
+            continue;
+        for (y = 0; y < cur->h; ++y)
+            if (!write_data(w, cur->bitmap + y * cur->stride, cur->w))
+                return 0;
+        n++;
+    }
+    if (!write_padding(w))
+        return 0;
+
+    iv = w->index + w->n_intervals++;
+    iv->start = start;
+    iv->end = start;
+    iv->n_images = n;
+    iv->reserved = 0;
+    iv->images_offset = w->pos;
+
+    offset = bitmaps;
+    for (cur = img; cur; cur = cur->next) {
+        if (cur->w <= 0 || cur->h <= 0)
+            continue;
+        rec.w = cur->w;
+        rec.h = cur->h;
+        rec.dst_x = cur->dst_x;
+        rec.dst_y = cur->dst_y;
+        rec.color = cur->color;
+        rec.type = cur->type;
+        rec.bitmap_offset = offset;
+        offset += (uint64_t) cur->w * cur->h;
+        if (!write_data(w, &rec, sizeof(rec)))
+            return 0;
+    }
+    return 1;
+}
+
+static int cmp_time(const void *a, const void *b)
+{
+    long long t1 = *(const long long *) a;
+    long long t2 = *(const long long *) b;
+    return (t1 > t2) - (t1 < t2);
+}
+
+/**
+ * \brief Render a whole track into a pre-rendered subtitle file.
+ * Frames are sampled at multiples of step ms and at every event boundary;
+ * runs of identical frames are merged into one interval.
+ */
+int ass_prerender_track(ASS_Renderer *priv, ASS_Track *track,
+                        const char *fname, int step)
+{
+    PrerenderWriter w;
+    PrerenderHeader header;
+    long long *times;
+    int n_times = 0;
+    int i, k;
+    int ok = 1;
+    int extend = 0;             // last interval still extends to now
+
+    if (step <= 0)
+        step = 40;
+
+    memset(&w, 0, sizeof(w));
+    w.fp = fopen(fname, "wb");
+    if (!w.fp) {
+        ass_msg(priv->library, MSGL_ERR, "Failed to open %s", fname);
+        return 1;
+    }
+
+    times = malloc((2 * track->n_events + 1) * sizeof(*times));
+    if (!times) {
+        fclose(w.fp);
+        return 1;
+    }
+    for (i = 0; i < track->n_events; ++i) {
+        ASS_Event *event = track->events + i;
+        times[n_times++] = event->Start;
+        times[n_times++] = event->Start + event->Duration;
+    }
+    qsort(times, n_times, sizeof(*times), cmp_time);
+
+    memset(&header, 0, sizeof(header));
+    ok &= write_data(&w, &header, sizeof(header));
+
+    for (k = 0; ok && k + 1 < n_times; ++k) {
+        long long now = times[k];
+        if (times[k + 1] == now)
+            continue;
+        while (ok && now < times[k + 1]) {
+            int change = 0;
+            // sample on a fixed grid so frame times line up with it
+            long long next = FFMIN(now - now % step + step, times[k + 1]);
+            ASS_Image *img = ass_render_frame(priv, track, now, &change);
+            if (!img)
+                extend = 0;
+            else if (!extend || change) {
+                ok &= write_interval(&w, img, now);
+                extend = 1;
+            }
+            if (extend && ok)
+                w.index[w.n_intervals - 1].end = next;
+            now = next;
+        }
+    }
+    free(times);
+
+    memcpy(header.magic, PRERENDER_MAGIC, sizeof(header.magic));
+    header.bom = PRERENDER_BOM;
+    header.version = PRERENDER_VERSION;
+    header.frame_w = priv->settings.frame_width;
+    header.frame_h = priv->settings.frame_height;
+    header.n_intervals = w.n_intervals;
+    if (ok)
+        ok &= write_padding(&w);
+    header.index_offset = w.pos;
+    if (ok)
+        ok &= write_data(&w, w.index,
+                         w.n_intervals * sizeof(PrerenderInterval));
+    if (ok)
+        ok &= !fseek(w.fp, 0, SEEK_SET) &&
+              fwrite(&header, sizeof(header), 1, w.fp) == 1;
+    if (fclose(w.fp))
+        ok = 0;
+    free(w.index);
+
+    if (!ok) {
+        ass_msg(priv->library, MSGL_ERR, "Failed to write %s", fname);
+        return 1;
+    }
+    ass_msg(priv->library, MSGL_INFO, "Pre-rendered %d intervals to %s",
+            w.n_intervals, fname);
+    return 0;
+}
+
+static int load_file(ASS_Prerendered *p, const char *fname)
+{
+#ifdef HAVE_SYS_MMAN_H
+    struct stat st;
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) || st.st_size <= 0) {
+        close(fd);
+        return 0;
+    }
+    p->size = st.st_size;
+    p->data = mmap(NULL, p->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p->data == MAP_FAILED) {
+        p->data = NULL;
+        return 0;
+    }
+    p->mapped = 1;
+    return 1;
+#else
+    long size;
+    FILE *fp = fopen(fname, "rb");
+    if (!fp)
+        return 0;
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0 || !(p->data = malloc(size)) ||
+        fread(p->data, size, 1, fp) != 1) {
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    p->size = size;
+    return 1;
+#endif
+}
+
+/**
+ * \brief Validate the index and image records of a loaded file.
+ */
+static int check_file(ASS_Prerendered *p)
+{
+    PrerenderHeader *h = (PrerenderHeader *) p->data;
+    uint32_t i, j;
+
+    if (p->size < sizeof(*h) || memcmp(h->magic, PRERENDER_MAGIC, 8) ||
+        h->bom != PRERENDER_BOM || h->version != PRERENDER_VERSION)
+        return 0;
+    if (h->index_offset > p->size || h->index_offset & 7 ||
+        h->n_intervals >
+        (p->size - h->index_offset) / sizeof(PrerenderInterval))
+        return 0;
+    p->header = h;
+    p->index = (PrerenderInterval *) (p->data + h->index_offset);
+
+    for (i = 0; i < h->n_intervals; ++i) {
+        PrerenderInterval *iv = p->index + i;
+        PrerenderImage *rec;
+        if (iv->images_offset > p->size || iv->images_offset & 7 ||
+            iv->n_images >
+            (p->size - iv->images_offset) / sizeof(PrerenderImage))
+            return 0;
+        if (i && iv->start < p->index[i - 1].end)
+            return 0;
+        rec = (PrerenderImage *) (p->data + iv->images_offset);
+        for (j = 0; j < iv->n_images; ++j) {
+            uint64_t size = (uint64_t) rec[j].w * rec[j].h;
+            if (rec[j].w <= 0 || rec[j].h <= 0 ||
+                rec[j].bitmap_offset > p->size ||
+                size > p->size - rec[j].bitmap_offset)
+                return 0;
+        }
+        p->max_images = FFMAX(p->max_images, (int) iv->n_images);
+    }
+    return 1;
+}
+
+ASS_Prerendered *ass_prerendered_open(const char *fname)
+{
+    ASS_Prerendered *p = calloc(1, sizeof(*p));
+    if (!p)
+        return NULL;
+
+    if (!load_file(p, fname) || !check_file(p)) {
+        ass_prerendered_close(p);
+        return NULL;
+    }
+    if (p->max_images) {
+        p->images = calloc(p->max_images, sizeof(ASS_Image));
+        if (!p->images) {
+            ass_prerendered_close(p);
+            return NULL;
+        }
+    }
+    return p;
+}
+
+void ass_prerendered_frame_size(ASS_Prerendered *p, int *w, int *h)
+{
+    *w = p->header->frame_w;
+    *h = p->header->frame_h;
+}
+
+ASS_Image *ass_prerendered_get(ASS_Prerendered *p, long long now)
+{
+    PrerenderInterval *iv;
+    PrerenderImage *rec;
+    int lo = 0, hi = p->header->n_intervals;
+    uint32_t i;
+
+    // find the last interval starting at or before now
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (p->index[mid].start <= now)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (!lo)
+        return NULL;
+    iv = p->index + lo - 1;
+    if (now >= iv->end || !iv->n_images)
+        return NULL;
+
+    rec = (PrerenderImage *) (p->data + iv->images_offset);
+    for (i = 0; i < iv->n_images; ++i) {
+        ASS_Image *img = p->images + i;
+        img->w = rec[i].w;
+        img->h = rec[i].h;
+        img->stride = rec[i].w;
+        img->bitmap = p->data + rec[i].bitmap_offset;
+        img->color = rec[i].color;
+        img->dst_x = rec[i].dst_x;
+        img->dst_y = rec[i].dst_y;
+        img->type = rec[i].type;
+        img->next = i + 1 < iv->n_images ? img + 1 : NULL;
+    }
+    return p->images;
+}
+
+void ass_prerendered_close(ASS_Prerendered *p)
+{
+    if (!p)
+        return;
+#ifdef HAVE_SYS_MMAN_H
+    if (p->mapped)
+        munmap(p->data, p->size);
+#else
+    free(p->data);
+#endif
+    free(p->images);
+    free(p);
+}
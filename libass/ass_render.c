@@ -19,6 +19,7 @@
 #include "config.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <math.h>
 #include <string.h>
 
@@ -101,6 +102,8 @@ ASS_Renderer *ass_renderer_init(ASS_Library *library)
     priv->cache.glyph_max = GLYPH_CACHE_MAX;
     priv->cache.bitmap_max_size = BITMAP_CACHE_MAX_SIZE;
     priv->cache.composite_max_size = COMPOSITE_CACHE_MAX_SIZE;
+    priv->cache.font_max = FONT_CACHE_MAX;
+    priv->cache.metrics_max = GLYPH_METRICS_CACHE_MAX;
 
     priv->text_info.max_bitmaps = MAX_BITMAPS_INITIAL;
     priv->text_info.max_glyphs = MAX_GLYPHS_INITIAL;
@@ -111,6 +114,7 @@ ASS_Renderer *ass_renderer_init(ASS_Library *library)
     priv->text_info.lines = calloc(MAX_LINES_INITIAL, sizeof(LineInfo));
 
     priv->settings.font_size_coeff = 1.;
+    priv->n_threads = 1;
 
     priv->shaper = ass_shaper_new(0);
     ass_shaper_info(library);
@@ -145,10 +149,14 @@ static void free_list_clear(ASS_Renderer *render_priv)
 
 void ass_renderer_done(ASS_Renderer *render_priv)
 {
-    ass_cache_done(render_priv->cache.font_cache);
+    ass_prefetch_free(render_priv->prefetch);
+
+    // glyph cache keys reference fonts, so the fonts go last
     ass_cache_done(render_priv->cache.bitmap_cache);
     ass_cache_done(render_priv->cache.composite_cache);
     ass_cache_done(render_priv->cache.outline_cache);
+    ass_shaper_empty_cache(render_priv->shaper, 0);
+    ass_cache_done(render_priv->cache.font_cache);
 
     ass_free_images(render_priv->images_root);
     ass_free_images(render_priv->prev_images_root);
@@ -157,12 +165,16 @@ void ass_renderer_done(ASS_Renderer *render_priv)
         FT_Stroker_Done(render_priv->state.stroker);
         render_priv->state.stroker = 0;
     }
+    // left over from the last simple event, see free_render_context
+    free(render_priv->state.family);
+    ass_drawing_free(render_priv->state.drawing);
     if (render_priv->ftlibrary)
         FT_Done_FreeType(render_priv->ftlibrary);
     if (render_priv->fontconfig_priv)
         fontconfig_done(render_priv->fontconfig_priv);
     if (render_priv->synth_priv)
         ass_synth_done(render_priv->synth_priv);
+    ass_worker_pool_free(render_priv->workers);
     ass_shaper_free(render_priv->shaper);
     free(render_priv->eimg);
     free(render_priv->text_info.glyphs);
@@ -174,6 +186,7 @@ void ass_renderer_done(ASS_Renderer *render_priv)
     free(render_priv->settings.default_family);
 
     free_list_clear(render_priv);
+    ass_arena_free(&render_priv->arena);
     free(render_priv);
 }
 
@@ -492,7 +505,7 @@ static void blend_vector_clip(ASS_Renderer *render_priv,
     memset(&key, 0, sizeof(key));
     key.type = BITMAP_CLIP;
     key.u.clip.text = drawing->text;
-    val = ass_cache_get(render_priv->cache.bitmap_cache, &key);
+    val = ass_bitmap_cache_get(render_priv->cache.bitmap_cache, &key);
 
     if (val) {
         clip_bm = val->bm;
@@ -524,7 +537,7 @@ static void blend_vector_clip(ASS_Renderer *render_priv,
         memset(&v, 0, sizeof(v));
         key.u.clip.text = strdup(drawing->text);
         v.bm = clip_bm;
-        ass_cache_put(render_priv->cache.bitmap_cache, &key, &v);
+        ass_bitmap_cache_put(render_priv->cache.bitmap_cache, &key, &v);
     }
 
     if (!clip_bm) return;
@@ -726,8 +739,9 @@ static void compute_string_bbox(TextInfo *text, DBBox *bbox)
     int i;
 
     if (text->length > 0) {
-        bbox->xMin = 32000;
-        bbox->xMax = -32000;
+        // 26.6, converted once at the end
+        int x_min = 32000 * 64;
+        int x_max = -32000 * 64;
         bbox->yMin = -1 * text->lines[0].asc + d6_to_double(text->glyphs[0].pos.y);
         bbox->yMax = text->height - text->lines[0].asc +
                      d6_to_double(text->glyphs[0].pos.y);
@@ -735,11 +749,13 @@ static void compute_string_bbox(TextInfo *text, DBBox *bbox)
         for (i = 0; i < text->length; ++i) {
             GlyphInfo *info = text->glyphs + i;
             if (info->skip) continue;
-            double s = d6_to_double(info->pos.x);
-            double e = s + d6_to_double(info->cluster_advance.x);
-            bbox->xMin = FFMIN(bbox->xMin, s);
-            bbox->xMax = FFMAX(bbox->xMax, e);
+            int s = info->pos.x;
+            int e = s + info->cluster_advance.x;
+            x_min = FFMIN(x_min, s);
+            x_max = FFMAX(x_max, e);
         }
+        bbox->xMin = d6_to_double(x_min);
+        bbox->xMax = d6_to_double(x_max);
     } else
         bbox->xMin = bbox->xMax = bbox->yMin = bbox->yMax = 0.;
 }
@@ -788,21 +804,85 @@ void reset_render_context(ASS_Renderer *render_priv, ASS_Style *style)
     render_priv->state.font_encoding = style->Encoding;
 }
 
+/**
+ * \brief Hash the style fields that reset_render_context reads, so that
+ * the simple event fast path notices styles that were edited in place,
+ * e.g. by ass_process_force_style
+ */
+static uint64_t style_reset_hash(ASS_Style *style)
+{
+    uint64_t hval = ass_hash_str(style->FontName, ASS_HASH_INIT);
+    hval = ass_hash_buf(&style->FontSize, sizeof(style->FontSize), hval);
+    hval = ass_hash_mix(hval, style->PrimaryColour);
+    hval = ass_hash_mix(hval, style->SecondaryColour);
+    hval = ass_hash_mix(hval, style->OutlineColour);
+    hval = ass_hash_mix(hval, style->BackColour);
+    hval = ass_hash_mix(hval, style->Bold);
+    hval = ass_hash_mix(hval, style->Italic);
+    hval = ass_hash_mix(hval, style->Underline);
+    hval = ass_hash_mix(hval, style->StrikeOut);
+    hval = ass_hash_mix(hval, style->treat_fontname_as_pattern);
+    hval = ass_hash_mix(hval, style->BorderStyle);
+    hval = ass_hash_mix(hval, style->Encoding);
+    hval = ass_hash_buf(&style->ScaleX, sizeof(style->ScaleX), hval);
+    hval = ass_hash_buf(&style->ScaleY, sizeof(style->ScaleY), hval);
+    hval = ass_hash_buf(&style->Spacing, sizeof(style->Spacing), hval);
+    hval = ass_hash_buf(&style->Angle, sizeof(style->Angle), hval);
+    hval = ass_hash_buf(&style->Outline, sizeof(style->Outline), hval);
+    hval = ass_hash_buf(&style->Shadow, sizeof(style->Shadow), hval);
+    hval = ass_hash_buf(&style->Blur, sizeof(style->Blur), hval);
+    return hval;
+}
+
+/**
+ * \brief Check whether an event can never modify the render context.
+ * Such events have no override blocks and no transition effect.
+ */
+static int is_simple_event(ASS_Event *event, DecodedText *decoded)
+{
+    if (event->Effect && *event->Effect)
+        return 0;
+    return decoded ? decoded->simple : !strchr(event->Text, '{');
+}
+
 /**
  * \brief Start new event. Reset render_priv->state.
  */
 static void
-init_render_context(ASS_Renderer *render_priv, ASS_Event *event)
+init_render_context(ASS_Renderer *render_priv, ASS_Event *event,
+                    DecodedText *decoded)
 {
+    ASS_Track *track = render_priv->track;
+    ASS_Style *style = track->styles + event->Style;
+    int simple = is_simple_event(event, decoded);
+    uint64_t style_hash = simple ? style_reset_hash(style) : 0;
+
     render_priv->state.event = event;
-    render_priv->state.style = render_priv->track->styles + event->Style;
+    render_priv->state.style = style;
     render_priv->state.parsed_tags = 0;
 
-    reset_render_context(render_priv, render_priv->state.style);
-    render_priv->state.wrap_style = render_priv->track->WrapStyle;
+    // Fast path: a simple event leaves the context reset to its style, so
+    // the next simple event with the same style can skip the font lookup,
+    // stroker setup and drawing allocation.
+    if (!simple || render_priv->state.reset_style != style ||
+        render_priv->state.reset_n_styles != track->n_styles ||
+        render_priv->state.reset_hash != style_hash) {
+        render_priv->state.reset_style = NULL;
+        reset_render_context(render_priv, style);
+        ass_drawing_free(render_priv->state.drawing);
+        render_priv->state.drawing = ass_drawing_new(render_priv->library,
+                render_priv->ftlibrary);
+        if (simple) {
+            render_priv->state.reset_style = style;
+            render_priv->state.reset_n_styles = track->n_styles;
+            render_priv->state.reset_hash = style_hash;
+        }
+    } else if (render_priv->state.font)
+        render_priv->state.font->last_used = render_priv->cache.frames;
+    render_priv->state.wrap_style = track->WrapStyle;
 
     render_priv->state.evt_type = EVENT_NORMAL;
-    render_priv->state.alignment = render_priv->state.style->Alignment;
+    render_priv->state.alignment = style->Alignment;
     render_priv->state.pos_x = 0;
     render_priv->state.pos_y = 0;
     render_priv->state.org_x = 0;
@@ -810,8 +890,8 @@ init_render_context(ASS_Renderer *render_priv, ASS_Event *event)
     render_priv->state.have_origin = 0;
     render_priv->state.clip_x0 = 0;
     render_priv->state.clip_y0 = 0;
-    render_priv->state.clip_x1 = render_priv->track->PlayResX;
-    render_priv->state.clip_y1 = render_priv->track->PlayResY;
+    render_priv->state.clip_x1 = track->PlayResX;
+    render_priv->state.clip_y1 = track->PlayResY;
     render_priv->state.clip_mode = 0;
     render_priv->state.detect_collisions = 1;
     render_priv->state.fade = 0;
@@ -820,22 +900,24 @@ init_render_context(ASS_Renderer *render_priv, ASS_Event *event)
     render_priv->state.effect_timing = 0;
     render_priv->state.effect_skip_timing = 0;
     render_priv->state.bm_run_id = 0;
-    ass_drawing_free(render_priv->state.drawing);
-    render_priv->state.drawing = ass_drawing_new(render_priv->library,
-            render_priv->ftlibrary);
 
     apply_transition_effects(render_priv, event);
 }
 
 static void free_render_context(ASS_Renderer *render_priv)
 {
+    ass_drawing_free(render_priv->state.clip_drawing);
+    render_priv->state.clip_drawing = NULL;
+
+    // keep a reusable reset for the next simple event
+    if (render_priv->state.reset_style)
+        return;
+
     free(render_priv->state.family);
     ass_drawing_free(render_priv->state.drawing);
-    ass_drawing_free(render_priv->state.clip_drawing);
 
     render_priv->state.family = NULL;
     render_priv->state.drawing = NULL;
-    render_priv->state.clip_drawing = NULL;
 }
 
 /*
@@ -881,6 +963,38 @@ static void draw_opaque_box(ASS_Renderer *render_priv, GlyphInfo *info,
     ol->contours[ol->n_contours++] = ol->n_points - 1;
 }
 
+/**
+ * \brief Copy an outline into the per-frame arena
+ * The copy must not be passed to FT_Outline_Done or outline_free; it is
+ * released with the arena.
+ */
+static FT_Outline *arena_outline_copy(ASS_Renderer *render_priv,
+                                      FT_Outline *source)
+{
+    Arena *arena = &render_priv->arena;
+    FT_Outline *dest;
+
+    if (!source)
+        return NULL;
+
+    dest = ass_arena_alloc(arena, sizeof(*dest));
+    if (!dest)
+        return NULL;
+    dest->n_points = source->n_points;
+    dest->n_contours = source->n_contours;
+    dest->points = ass_arena_alloc(arena,
+                                   source->n_points * sizeof(FT_Vector));
+    dest->tags = ass_arena_alloc(arena, source->n_points);
+    dest->contours = ass_arena_alloc(arena,
+                                     source->n_contours * sizeof(short));
+    dest->flags = 0;
+    if (!dest->points || !dest->tags || !dest->contours)
+        return NULL;
+    FT_Outline_Copy(source, dest);
+
+    return dest;
+}
+
 /*
  * Stroke an outline glyph in x/y direction.  Applies various fixups to get
  * around limitations of the FreeType stroker.
@@ -919,21 +1033,17 @@ static void stroke_outline(ASS_Renderer *render_priv, FT_Outline *outline,
     // The outlines look uglier, but the emboldening never adds any points
     } else {
         int i;
-        FT_Outline nol;
-
-        FT_Outline_New(render_priv->ftlibrary, outline->n_points,
-                       outline->n_contours, &nol);
-        FT_Outline_Copy(outline, &nol);
+        FT_Outline *nol = arena_outline_copy(render_priv, outline);
+        if (!nol)
+            return;
 
         FT_Outline_Embolden(outline, sx * 2);
         FT_Outline_Translate(outline, -sx, -sx);
-        FT_Outline_Embolden(&nol, sy * 2);
-        FT_Outline_Translate(&nol, -sy, -sy);
+        FT_Outline_Embolden(nol, sy * 2);
+        FT_Outline_Translate(nol, -sy, -sy);
 
         for (i = 0; i < outline->n_points; i++)
-            outline->points[i].y = nol.points[i].y;
-
-        FT_Outline_Done(render_priv->ftlibrary, &nol);
+            outline->points[i].y = nol->points[i].y;
     }
 }
 
@@ -985,6 +1095,8 @@ fill_glyph_hash(ASS_Renderer *priv, OutlineHashKey *outline_key,
  */
 static void fill_composite_hash(CompositeHashKey *hk, CombinedBitmapInfo *info)
 {
+    // padding is hashed and compared too
+    memset(hk, 0, sizeof(*hk));
     hk->w = info->w;
     hk->h = info->h;
     hk->o_w = info->o_w;
@@ -1031,10 +1143,11 @@ get_outline_glyph(ASS_Renderer *priv, GlyphInfo *info)
     OutlineHashValue *val;
     OutlineHashKey key;
 
-    memset(&info->hash_key, 0, sizeof(key));
+    memset(&info->hash_key, 0, sizeof(info->hash_key));
+    memset(&key, 0, sizeof(key));
 
     fill_glyph_hash(priv, &key, info);
-    val = ass_cache_get(priv->cache.outline_cache, &key);
+    val = ass_outline_cache_get(priv->cache.outline_cache, &key);
 
     if (!val) {
         OutlineHashValue v;
@@ -1106,7 +1219,7 @@ get_outline_glyph(ASS_Renderer *priv, GlyphInfo *info)
         }
 
         v.lib = priv->ftlibrary;
-        val = ass_cache_put(priv->cache.outline_cache, &key, &v);
+        val = ass_outline_cache_put(priv->cache.outline_cache, &key, &v);
     }
 
     info->hash_key.u.outline.outline = val;
@@ -1213,7 +1326,8 @@ get_bitmap_glyph(ASS_Renderer *render_priv, GlyphInfo *info)
     if (!info->outline || info->symbol == '\n' || info->symbol == 0 || info->skip)
         return;
 
-    val = ass_cache_get(render_priv->cache.bitmap_cache, &info->hash_key);
+    val = ass_bitmap_cache_get(render_priv->cache.bitmap_cache,
+                               &info->hash_key);
 
     if (!val) {
         FT_Vector shift;
@@ -1225,8 +1339,8 @@ get_bitmap_glyph(ASS_Renderer *render_priv, GlyphInfo *info)
 
         hash_val.bm = hash_val.bm_o = hash_val.bm_s = 0;
 
-        outline_copy(render_priv->ftlibrary, info->outline, &outline);
-        outline_copy(render_priv->ftlibrary, info->border, &border);
+        outline = arena_outline_copy(render_priv, info->outline);
+        border = arena_outline_copy(render_priv, info->border);
 
         // calculating rotation shift vector (from rotation origin to the glyph basepoint)
         shift.x = key->shift_x;
@@ -1270,11 +1384,8 @@ get_bitmap_glyph(ASS_Renderer *render_priv, GlyphInfo *info)
         if (error)
             info->symbol = 0;
 
-        val = ass_cache_put(render_priv->cache.bitmap_cache, &info->hash_key,
-                &hash_val);
-
-        outline_free(render_priv->ftlibrary, outline);
-        outline_free(render_priv->ftlibrary, border);
+        val = ass_bitmap_cache_put(render_priv->cache.bitmap_cache,
+                                   &info->hash_key, &hash_val);
     }
 
     info->bm = val->bm;
@@ -1293,30 +1404,32 @@ static void measure_text(ASS_Renderer *render_priv)
 {
     TextInfo *text_info = &render_priv->text_info;
     int cur_line = 0;
-    double max_asc = 0., max_desc = 0.;
+    int max_asc = 0, max_desc = 0;     // 26.6
     GlyphInfo *last = NULL;
     int i;
     int empty_line = 1;
     text_info->height = 0.;
     for (i = 0; i < text_info->length + 1; ++i) {
         if ((i == text_info->length) || text_info->glyphs[i].linebreak) {
+            double asc = d6_to_double(max_asc);
+            double desc = d6_to_double(max_desc);
             if (empty_line && cur_line > 0 && last) {
-                max_asc = d6_to_double(last->asc) / 2.0;
-                max_desc = d6_to_double(last->desc) / 2.0;
+                asc = d6_to_double(last->asc) / 2.0;
+                desc = d6_to_double(last->desc) / 2.0;
             }
-            text_info->lines[cur_line].asc = max_asc;
-            text_info->lines[cur_line].desc = max_desc;
-            text_info->height += max_asc + max_desc;
+            text_info->lines[cur_line].asc = asc;
+            text_info->lines[cur_line].desc = desc;
+            text_info->height += asc + desc;
             cur_line++;
-            max_asc = max_desc = 0.;
+            max_asc = max_desc = 0;
             empty_line = 1;
         }
         if (i < text_info->length) {
             GlyphInfo *cur = text_info->glyphs + i;
-            if (d6_to_double(cur->asc) > max_asc)
-                max_asc = d6_to_double(cur->asc);
-            if (d6_to_double(cur->desc) > max_desc)
-                max_desc = d6_to_double(cur->desc);
+            if (cur->asc > max_asc)
+                max_asc = cur->asc;
+            if (cur->desc > max_desc)
+                max_desc = cur->desc;
             if (cur->symbol != '\n' && cur->symbol != 0) {
                 empty_line = 0;
                 last = cur;
@@ -1384,16 +1497,135 @@ static void trim_whitespace(ASS_Renderer *render_priv)
 }
 #undef IS_WHITESPACE
 
+typedef struct {
+    int start;          // index of the first glyph of the line
+    int last;           // last visible glyph before start, or -1
+    int lines;          // number of lines from here to paragraph end
+    int next;           // candidate that starts the following line
+    double cost;        // sum of squared slack from here to paragraph end
+} WrapCandidate;
+
+/**
+ * \brief Pick soft line breaks of one paragraph with minimum raggedness
+ * \param cand break candidates, cand[n].start is the paragraph end
+ * \param n number of break candidates
+ * \param max_width maximal line width, 26.6
+ * The number of lines is minimized first, then the sum of squared
+ * differences between max_width and the line widths, which balances
+ * the lines. Ties prefer a wider upper line. The width of a line only
+ * grows with the number of words on it, so each candidate examines only
+ * the words that fit on one line.
+ */
+static void wrap_paragraph(TextInfo *text_info, WrapCandidate *cand, int n,
+                           int max_width)
+{
+    GlyphInfo *glyphs = text_info->glyphs;
+    int k, m;
+
+    cand[n].lines = 0;
+    cand[n].cost = 0.;
+    cand[n].next = n;
+    for (k = n - 1; k >= 0; --k) {
+        int x0 = glyphs[cand[k].start].bbox.xMin +
+                 glyphs[cand[k].start].pos.x;
+        cand[k].lines = INT_MAX;
+        cand[k].next = n;
+        for (m = k + 1; m <= n; ++m) {
+            int last = cand[m].last;
+            int width = 0;
+            double slack, cost;
+            int lines;
+            if (last >= cand[k].start)
+                width = glyphs[last].bbox.xMax + glyphs[last].pos.x - x0;
+            // a single word wider than max_width gets a line of its own
+            if (width >= max_width && m > k + 1)
+                break;
+            slack = d6_to_double(FFMAX(max_width - width, 0));
+            lines = cand[m].lines + 1;
+            cost = cand[m].cost + slack * slack;
+            if (lines < cand[k].lines ||
+                (lines == cand[k].lines && cost <= cand[k].cost)) {
+                cand[k].lines = lines;
+                cand[k].cost = cost;
+                cand[k].next = m;
+            }
+        }
+    }
+
+    for (k = cand[0].next; k < n; k = cand[k].next)
+        glyphs[cand[k].start].linebreak = 1;
+}
+
+/**
+ * \brief Rebalance soft line breaks for wrap style 0
+ * \param max_width maximal text line width, 26.6, the same threshold
+ * the greedy pass of wrap_lines_smart uses
+ * Every paragraph (text between hard breaks) is wrapped separately by
+ * wrap_paragraph. Break candidates are the starts of words.
+ */
+static void
+wrap_lines_balanced(ASS_Renderer *render_priv, int max_width)
+{
+    TextInfo *text_info = &render_priv->text_info;
+    GlyphInfo *glyphs = text_info->glyphs;
+    WrapCandidate *cand;
+    int i, n, last;
+
+    cand = malloc((text_info->length + 1) * sizeof(*cand));
+    if (!cand)
+        return;
+
+    n = 0;
+    last = -1;
+    for (i = 0; i <= text_info->length; ++i) {
+        GlyphInfo *cur = glyphs + i;
+        if (i < text_info->length && cur->linebreak == 1)
+            cur->linebreak = 0;     // soft breaks are chosen anew
+        if (i == text_info->length || cur->linebreak == 2) {
+            if (n) {
+                cand[n].start = i;
+                cand[n].last = last;
+                wrap_paragraph(text_info, cand, n, max_width);
+            }
+            if (i == text_info->length)
+                break;
+            n = 0;
+        }
+        if (n == 0 || (cur->symbol != ' ' && cur->symbol != '\n' &&
+                       glyphs[i - 1].symbol == ' ')) {
+            cand[n].start = i;
+            cand[n].last = last;
+            n++;
+        }
+        if (cur->symbol != ' ' && cur->symbol != '\n')
+            last = i;
+    }
+    free(cand);
+
+    text_info->n_lines = 1;
+    for (i = 0; i < text_info->length; ++i)
+        if (glyphs[i].linebreak)
+            text_info->n_lines++;
+    if (text_info->n_lines > text_info->max_lines) {
+        while (text_info->n_lines > text_info->max_lines)
+            text_info->max_lines *= 2;
+        text_info->lines = realloc(text_info->lines,
+                                   sizeof(LineInfo) * text_info->max_lines);
+    }
+}
+
 /**
  * \brief rearrange text between lines
  * \param max_text_width maximal text line width in pixels
  * The algo is similar to the one in libvo/sub.c:
  * 1. Place text, wrapping it when current line is full
- * 2. Try moving words from the end of a line to the beginning of the next one while it reduces
- * the difference in lengths between this two lines.
- * The result may not be optimal, but usually is good enough.
+ * 2. For style 0, rebalance each paragraph with a minimum raggedness
+ * line breaker (wrap_lines_balanced).
+ * For style 3, try moving words from the end of a line to the beginning of
+ * the next one while it reduces the difference in lengths between this two
+ * lines. The result may not be optimal, but usually is good enough.
  *
- * FIXME: implement style 0 and 3 correctly
+ * FIXME: implement style 3 correctly
  */
 static void
 wrap_lines_smart(ASS_Renderer *render_priv, double max_text_width)
@@ -1403,11 +1635,16 @@ wrap_lines_smart(ASS_Renderer *render_priv, double max_text_width)
     int last_space;
     int break_type;
     int exit;
-    double pen_shift_x;
+    int pen_shift_x;
     double pen_shift_y;
     int cur_line;
     int run_offset;
     TextInfo *text_info = &render_priv->text_info;
+    // widths below are compared in 26.6; len >= max_width is exactly
+    // d6_to_double(len) >= max_text_width
+    double max_width_d6 = ceil(max_text_width * 64);
+    int max_width = max_width_d6 > INT_MAX ? INT_MAX :
+                    max_width_d6 < INT_MIN ? INT_MIN : (int) max_width_d6;
 
     last_space = -1;
     text_info->n_lines = 1;
@@ -1415,10 +1652,9 @@ wrap_lines_smart(ASS_Renderer *render_priv, double max_text_width)
     s1 = text_info->glyphs;     // current line start
     for (i = 0; i < text_info->length; ++i) {
         int break_at = -1;
-        double s_offset, len;
+        int len;
         cur = text_info->glyphs + i;
-        s_offset = d6_to_double(s1->bbox.xMin + s1->pos.x);
-        len = d6_to_double(cur->bbox.xMax + cur->pos.x) - s_offset;
+        len = (cur->bbox.xMax + cur->pos.x) - (s1->bbox.xMin + s1->pos.x);
 
         if (cur->symbol == '\n') {
             break_type = 2;
@@ -1427,7 +1663,7 @@ wrap_lines_smart(ASS_Renderer *render_priv, double max_text_width)
                     "forced line break at %d", break_at);
         } else if (cur->symbol == ' ') {
             last_space = i;
-        } else if (len >= max_text_width
+        } else if (len >= max_width
                    && (render_priv->state.wrap_style != 2)) {
             break_type = 1;
             break_at = last_space;
@@ -1451,13 +1687,16 @@ wrap_lines_smart(ASS_Renderer *render_priv, double max_text_width)
                 text_info->glyphs[lead].linebreak = break_type;
                 last_space = -1;
                 s1 = text_info->glyphs + lead;
-                s_offset = d6_to_double(s1->bbox.xMin + s1->pos.x);
                 text_info->n_lines++;
             }
         }
     }
 #define DIFF(x,y) (((x) < (y)) ? (y - x) : (x - y))
     exit = 0;
+    if (render_priv->state.wrap_style == 0) {
+        wrap_lines_balanced(render_priv, max_width);
+        exit = 1;
+    }
     while (!exit && render_priv->state.wrap_style != 1) {
         exit = 1;
         w = s3 = text_info->glyphs;
@@ -1469,7 +1708,7 @@ wrap_lines_smart(ASS_Renderer *render_priv, double max_text_width)
                 s2 = s3;
                 s3 = cur;
                 if (s1 && (s2->linebreak == 1)) {       // have at least 2 lines, and linebreak is 'soft'
-                    double l1, l2, l1_new, l2_new;
+                    int l1, l2, l1_new, l2_new;
 
                     w = s2;
                     do {
@@ -1485,16 +1724,14 @@ wrap_lines_smart(ASS_Renderer *render_priv, double max_text_width)
                     if (w->symbol == ' ')
                         ++w;
 
-                    l1 = d6_to_double(((s2 - 1)->bbox.xMax + (s2 - 1)->pos.x) -
-                        (s1->bbox.xMin + s1->pos.x));
-                    l2 = d6_to_double(((s3 - 1)->bbox.xMax + (s3 - 1)->pos.x) -
-                        (s2->bbox.xMin + s2->pos.x));
-                    l1_new = d6_to_double(
-                        (e1->bbox.xMax + e1->pos.x) -
-                        (s1->bbox.xMin + s1->pos.x));
-                    l2_new = d6_to_double(
-                        ((s3 - 1)->bbox.xMax + (s3 - 1)->pos.x) -
-                        (w->bbox.xMin + w->pos.x));
+                    l1 = ((s2 - 1)->bbox.xMax + (s2 - 1)->pos.x) -
+                        (s1->bbox.xMin + s1->pos.x);
+                    l2 = ((s3 - 1)->bbox.xMax + (s3 - 1)->pos.x) -
+                        (s2->bbox.xMin + s2->pos.x);
+                    l1_new = (e1->bbox.xMax + e1->pos.x) -
+                        (s1->bbox.xMin + s1->pos.x);
+                    l2_new = ((s3 - 1)->bbox.xMax + (s3 - 1)->pos.x) -
+                        (w->bbox.xMin + w->pos.x);
 
                     if (DIFF(l1_new, l2_new) < DIFF(l1, l2)) {
                         w->linebreak = 1;
@@ -1514,7 +1751,7 @@ wrap_lines_smart(ASS_Renderer *render_priv, double max_text_width)
     measure_text(render_priv);
     trim_whitespace(render_priv);
 
-    pen_shift_x = 0.;
+    pen_shift_x = 0;
     pen_shift_y = 0.;
     cur_line = 1;
     run_offset = 0;
@@ -1523,7 +1760,7 @@ wrap_lines_smart(ASS_Renderer *render_priv, double max_text_width)
     cur = text_info->glyphs + i;
     while (i < text_info->length && cur->skip)
         cur = text_info->glyphs + ++i;
-    pen_shift_x = d6_to_double(-cur->pos.x);
+    pen_shift_x = -cur->pos.x;
 
     for (i = 0; i < text_info->length; ++i) {
         cur = text_info->glyphs + i;
@@ -1538,10 +1775,10 @@ wrap_lines_smart(ASS_Renderer *render_priv, double max_text_width)
             text_info->lines[cur_line].offset = i;
             cur_line++;
             run_offset++;
-            pen_shift_x = d6_to_double(-cur->pos.x);
+            pen_shift_x = -cur->pos.x;
             pen_shift_y += height + render_priv->settings.line_spacing;
         }
-        cur->pos.x += double_to_d6(pen_shift_x);
+        cur->pos.x += pen_shift_x;
         cur->pos.y += double_to_d6(pen_shift_y);
     }
     text_info->lines[cur_line - 1].len =
@@ -1684,6 +1921,133 @@ static int is_new_bm_run(GlyphInfo *info, GlyphInfo *last)
     return 0;
 }
 
+/**
+ * \brief Check whether a glyph is invisible in the region of interest
+ * \param x, y device position of the event
+ * \param vertical_ok whether the event keeps its vertical position; if not
+ * (it may still be moved by collision detection), only check horizontally
+ * \return 1 if nothing of the glyph, including border, shadow and blur,
+ * can end up in render_priv->roi
+ */
+static int glyph_outside_roi(ASS_Renderer *render_priv, GlyphInfo *info,
+                             double x, double y, int vertical_ok)
+{
+    Rect *roi = &render_priv->roi;
+    double x0, x1, y0, y1, pad;
+
+    // transformed glyphs and opaque boxes are not covered by the bbox
+    if (info->frx || info->fry || info->frz || info->fax || info->fay ||
+        info->border_style == 3)
+        return 0;
+
+    pad = FFMAX(info->be > 0 ? sqrt(2 * info->be) : 0,
+                info->blur * render_priv->blur_scale * 2 + 1);
+    pad += FFMAX(info->border_x, info->border_y) * render_priv->border_scale;
+    pad += FFMAX(fabs(info->shadow_x), fabs(info->shadow_y)) *
+           render_priv->border_scale;
+    pad += 2;                   // rounding and subpixel shifts
+
+    x0 = x + d6_to_double(info->pos.x + info->bbox.xMin) *
+             render_priv->font_scale_x - pad;
+    x1 = x + d6_to_double(info->pos.x + info->bbox.xMax) *
+             render_priv->font_scale_x + pad;
+    y0 = y + d6_to_double(info->pos.y - info->bbox.yMax) - pad;
+    y1 = y + d6_to_double(info->pos.y - info->bbox.yMin) + pad;
+
+    return x1 <= roi->x0 || x0 >= roi->x1 ||
+           (vertical_ok && (y1 <= roi->y0 || y0 >= roi->y1));
+}
+
+/**
+ * \brief Mark the clusters [start, end) as skipped
+ */
+static void cull_clusters(TextInfo *text_info, int start, int end)
+{
+    int i;
+
+    for (i = start; i < end; ++i) {
+        GlyphInfo *info = text_info->glyphs + i;
+        if (info->skip)
+            continue;
+        if (info->drawing) {
+            ass_drawing_free(info->drawing);
+            info->drawing = NULL;
+        }
+        info->skip = 1;
+    }
+    // make the glyphs after them start a new bitmap run, as before
+    text_info->glyphs[end - 1].linebreak = 1;
+}
+
+/**
+ * \brief Skip bitmap runs that are invisible in the region of interest
+ * Runs are found the same way as when combining bitmaps in ass_render_event.
+ * Only whole runs are skipped, because combining the remaining glyphs
+ * differently would change the result (e.g. shadow edges).
+ * \param x, y device position of the event
+ */
+static void cull_bitmap_runs(ASS_Renderer *render_priv, double x, double y)
+{
+    TextInfo *text_info = &render_priv->text_info;
+    GlyphInfo *glyphs = text_info->glyphs;
+    int vertical_ok = !render_priv->state.detect_collisions;
+    GlyphInfo *last = NULL;
+    char linebreak = 0;
+    int start = -1;             // first cluster of the run, -1 if none
+    int visible = 1;
+    int i;
+
+    for (i = 0; i < text_info->length; ++i) {
+        GlyphInfo *info = glyphs + i;
+        if (info->linebreak) linebreak = 1;
+        if (info->skip) continue;
+        for (; info; info = info->next) {
+            if (linebreak || is_new_bm_run(info, last)) {
+                linebreak = 0;
+                // runs starting or ending inside a cluster are kept
+                if (!visible && start >= 0 && info == glyphs + i)
+                    cull_clusters(text_info, start, i);
+                start = info == glyphs + i ? i : -1;
+                visible = 0;
+            }
+            if (!visible)
+                visible = !glyph_outside_roi(render_priv, info, x, y,
+                                             vertical_ok);
+            last = info;
+        }
+    }
+    if (!visible && start >= 0)
+        cull_clusters(text_info, start, text_info->length);
+}
+
+/**
+ * \brief Get the worker pool, starting its threads on first use
+ * \return pool or NULL if rendering is single-threaded
+ */
+static ASS_WorkerPool *get_worker_pool(ASS_Renderer *render_priv)
+{
+    if (!render_priv->workers_init) {
+        int n = render_priv->n_threads;
+        if (!n)
+            n = FFMIN(ass_cpu_count(), WORKER_AUTO_MAX_THREADS);
+        render_priv->workers = ass_worker_pool_new(n);
+        render_priv->workers_init = 1;
+    }
+    return render_priv->workers;
+}
+
+/**
+ * \brief Get the worker pool for blurring a bitmap, or NULL if it is too
+ * small to be split, so small blurs never start the threads
+ */
+static ASS_WorkerPool *blur_pool(ASS_Renderer *render_priv, Bitmap *bm)
+{
+    if (render_priv->n_threads == 1 ||
+        (size_t) bm->w * bm->h < BLUR_TILE_MIN_AREA)
+        return NULL;
+    return get_worker_pool(render_priv);
+}
+
 static void apply_blur(CombinedBitmapInfo *info, ASS_Renderer *render_priv)
 {
     int be = info->be;
@@ -1739,15 +2103,11 @@ static void apply_blur(CombinedBitmapInfo *info, ASS_Renderer *render_priv)
     if (blur_radius > 0.0) {
         generate_tables(priv_blur, blur_radius);
         if (bm_o)
-            ass_gauss_blur(bm_o->buffer, priv_blur->tmp,
-                           bm_o->w, bm_o->h, bm_o->stride,
-                           priv_blur->gt2, priv_blur->g_r,
-                           priv_blur->g_w);
+            ass_gauss_blur_bitmap(priv_blur, blur_pool(render_priv, bm_o),
+                                  bm_o);
         if (!bm_o || border_style == 3)
-            ass_gauss_blur(bm_g->buffer, priv_blur->tmp,
-                           bm_g->w, bm_g->h, bm_g->stride,
-                           priv_blur->gt2, priv_blur->g_r,
-                           priv_blur->g_w);
+            ass_gauss_blur_bitmap(priv_blur, blur_pool(render_priv, bm_g),
+                                  bm_g);
     }
 }
 
@@ -1776,6 +2136,71 @@ static void make_shadow_bitmap(CombinedBitmapInfo *info)
     shift_bitmap(info->bm_s, info->shadow_x, info->shadow_y);
 }
 
+/**
+ * \brief Position in the text of an event.  With pre-decoded text, p is
+ * only used inside override blocks.
+ */
+typedef struct {
+    char *text;
+    char *p;
+    uint32_t *unit;             // next decoded unit, NULL if not decoded
+} TextPos;
+
+static inline int text_at_tags(TextPos *pos)
+{
+    if (pos->unit)
+        return (*pos->unit & TEXT_TAGS) != 0;
+    return *pos->p == '{';
+}
+
+static inline void text_enter_tags(TextPos *pos)
+{
+    if (pos->unit) {
+        pos->p = pos->text + (*pos->unit & ~TEXT_TAGS);
+        pos->unit++;
+    } else
+        pos->p++;
+}
+
+/**
+ * \brief Continue after an override block; p points to its '}'
+ */
+static inline void text_leave_tags(TextPos *pos)
+{
+    pos->p++;
+    if (pos->unit) {
+        // the block ended where the decoder expected, or we are on our own
+        if (pos->p == pos->text + *pos->unit)
+            pos->unit++;
+        else
+            pos->unit = NULL;
+    }
+}
+
+static inline int text_at_end(TextPos *pos, int in_tag)
+{
+    if (pos->unit && !in_tag)
+        return !*pos->unit;
+    return !*pos->p;
+}
+
+static inline unsigned text_next_char(ASS_Renderer *render_priv,
+                                      TextPos *pos)
+{
+    uint32_t code;
+
+    if (!pos->unit)
+        return get_next_char(render_priv, &pos->p);
+
+    code = *pos->unit;
+    if (!code)
+        return 0;
+    pos->unit++;
+    if (code == TEXT_SOFT_BREAK)
+        return render_priv->state.wrap_style == 2 ? '\n' : ' ';
+    return code;
+}
+
 /**
  * \brief Main ass rendering function, glues everything together
  * \param event event to render
@@ -1786,7 +2211,8 @@ static int
 ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
                  EventImages *event_images)
 {
-    char *p;
+    TextPos pos;
+    DecodedText *decoded = NULL;
     FT_Vector pen;
     unsigned code;
     DBBox bbox;
@@ -1809,11 +2235,15 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
         return 1;
     }
 
-    init_render_context(render_priv, event);
+    if (render_priv->library->predecode_text)
+        decoded = ass_event_decoded_text(event);
+    init_render_context(render_priv, event, decoded);
 
     drawing = render_priv->state.drawing;
     text_info->length = 0;
-    p = event->Text;
+    pos.text = event->Text;
+    pos.p = event->Text;
+    pos.unit = decoded ? decoded->units : NULL;
 
     int in_tag = 0;
 
@@ -1823,8 +2253,8 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
         // this affects render_context
         do {
             code = 0;
-            if (!in_tag && *p == '{') {            // '\0' goes here
-                p++;
+            if (!in_tag && text_at_tags(&pos)) {   // '\0' goes here
+                text_enter_tags(&pos);
                 in_tag = 1;
                 if (render_priv->state.drawing_scale) {
                     // A drawing definition has just ended.
@@ -1836,23 +2266,23 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
                 }
             }
             if (in_tag) {
-                p = parse_tag(render_priv, p, 1.);
-                if (*p == '}') {    // end of tag
-                    p++;
+                pos.p = parse_tag(render_priv, pos.p, 1.);
+                if (*pos.p == '}') {    // end of tag
+                    text_leave_tags(&pos);
                     in_tag = 0;
-                } else if (*p != '\\') {
+                } else if (*pos.p != '\\') {
                     ass_msg(render_priv->library, MSGL_V,
-                            "Unable to parse: '%.30s'", p);
+                            "Unable to parse: '%.30s'", pos.p);
                 }
             } else {
-                code = get_next_char(render_priv, &p);
+                code = text_next_char(render_priv, &pos);
                 if (code && render_priv->state.drawing_scale) {
                     ass_drawing_add_char(drawing, (char) code);
                     continue;   // skip everything in drawing mode
                 }
                 break;
             }
-        } while (*p);
+        } while (!text_at_end(&pos, in_tag));
 
         if (text_info->length >= text_info->max_glyphs) {
             // Raise maximum number of glyphs
@@ -2043,7 +2473,7 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
     pen.x = 0;
     pen.y = 0;
     int lineno = 1;
-    double last_pen_x = 0;
+    FT_Pos last_pen_x = 0;
     double last_fay = 0;
     for (i = 0; i < text_info->length; i++) {
         GlyphInfo *info = glyphs + cmap[i];
@@ -2077,21 +2507,23 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
     // align lines
     if (render_priv->state.evt_type != EVENT_HSCROLL) {
         last_break = -1;
-        double width = 0;
+        int width = 0;      // 26.6
         for (i = 0; i <= text_info->length; ++i) {   // (text_info->length + 1) is the end of the last line
             if ((i == text_info->length) || glyphs[i].linebreak) {
                 double shift = 0;
+                int shift_d6;
                 if (halign == HALIGN_LEFT) {    // left aligned, no action
                     shift = 0;
                 } else if (halign == HALIGN_RIGHT) {    // right aligned
-                    shift = max_text_width - width;
+                    shift = max_text_width - d6_to_double(width);
                 } else if (halign == HALIGN_CENTER) {   // centered
-                    shift = (max_text_width - width) / 2.0;
+                    shift = (max_text_width - d6_to_double(width)) / 2.0;
                 }
+                shift_d6 = double_to_d6(shift);
                 for (j = last_break + 1; j < i; ++j) {
                     GlyphInfo *info = glyphs + j;
                     while (info) {
-                        info->pos.x += double_to_d6(shift);
+                        info->pos.x += shift_d6;
                         info = info->next;
                     }
                 }
@@ -2100,7 +2532,7 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
             }
             if (i < text_info->length && !glyphs[i].skip &&
                     glyphs[i].symbol != '\n' && glyphs[i].symbol != 0) {
-                width += d6_to_double(glyphs[i].cluster_advance.x);
+                width += glyphs[i].cluster_advance.x;
             }
         }
     }
@@ -2233,14 +2665,16 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
             center.y = device_y + by;
         }
 
+        int offset_x = double_to_d6(device_x - center.x);
+        int offset_y = double_to_d6(device_y - center.y);
         for (i = 0; i < text_info->length; ++i) {
             GlyphInfo *info = glyphs + i;
             while (info) {
                 OutlineBitmapHashKey *key = &info->hash_key.u.outline;
 
                 if (key->frx || key->fry || key->frz || key->fax || key->fay) {
-                    key->shift_x = info->pos.x + double_to_d6(device_x - center.x);
-                    key->shift_y = -(info->pos.y + double_to_d6(device_y - center.y));
+                    key->shift_x = info->pos.x + offset_x;
+                    key->shift_y = -(info->pos.y + offset_y);
                 } else {
                     key->shift_x = 0;
                     key->shift_y = 0;
@@ -2253,11 +2687,18 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
     // convert glyphs to bitmaps
     int left = render_priv->settings.left_margin;
     device_x = (device_x - left) * render_priv->font_scale_x + left;
+    double frac_x = device_x - (int) device_x;
+    double frac_y = device_y - (int) device_y;
     unsigned nb_bitmaps = 0;
     char linebreak = 0;
     CombinedBitmapInfo *combined_info = text_info->combined_bitmaps;
     CombinedBitmapInfo *current_info = NULL;
     GlyphInfo *last_info = NULL;
+
+    // with a region of interest, don't rasterize what cannot show up in it
+    if (render_priv->use_roi)
+        cull_bitmap_runs(render_priv, device_x, device_y);
+
     for (i = 0; i < text_info->length; ++i) {
         GlyphInfo *info = glyphs + i;
         if (info->linebreak) linebreak = 1;
@@ -2266,10 +2707,10 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
             OutlineBitmapHashKey *key = &info->hash_key.u.outline;
             info->pos.x *= render_priv->font_scale_x;
             key->advance.x =
-                double_to_d6(device_x - (int) device_x +
+                double_to_d6(frac_x +
                         d6_to_double(info->pos.x & SUBPIXEL_MASK)) & ~SUBPIXEL_ACCURACY;
             key->advance.y =
-                double_to_d6(device_y - (int) device_y +
+                double_to_d6(frac_y +
                         d6_to_double(info->pos.y & SUBPIXEL_MASK)) & ~SUBPIXEL_ACCURACY;
             get_bitmap_glyph(render_priv, info);
 
@@ -2345,7 +2786,9 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
 
                 current_info->max_str_length = MAX_STR_LENGTH_INITIAL;
                 current_info->str_length = 0;
-                current_info->str = malloc(MAX_STR_LENGTH_INITIAL);
+                // without a key string the run is dropped, see below
+                current_info->str = ass_arena_alloc(&render_priv->arena,
+                                                    MAX_STR_LENGTH_INITIAL);
                 current_info->chars = 0;
 
                 current_info->w = current_info->h = current_info->o_w = current_info->o_h = 0;
@@ -2353,20 +2796,26 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
             }
 
             if(info->drawing){
-                free(current_info->str);
-                current_info->str = strdup(info->drawing->text);
+                size_t len = strlen(info->drawing->text) + 1;
+                current_info->str = ass_arena_alloc(&render_priv->arena, len);
+                if (current_info->str)
+                    memcpy(current_info->str, info->drawing->text, len);
                 current_info->is_drawing = 1;
                 ass_drawing_free(info->drawing);
-            }else{
+            }else if(current_info->str){
                 current_info->str_length +=
                     ass_utf8_put_char(
                         current_info->str + current_info->str_length,
                         info->symbol);
                 current_info->chars++;
                 if(current_info->str_length > current_info->max_str_length - 5){
+                    char *str = current_info->str;
                     current_info->max_str_length *= 2;
-                    current_info->str = realloc(current_info->str,
-                                                current_info->max_str_length);
+                    current_info->str = ass_arena_alloc(&render_priv->arena,
+                            current_info->max_str_length);
+                    if (current_info->str)
+                        memcpy(current_info->str, str,
+                               current_info->str_length + 1);
                 }
             }
 
@@ -2410,16 +2859,19 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
     for (i = 0; i < nb_bitmaps; ++i) {
         CombinedBitmapInfo *info = &combined_info[i];
 
+        // out of memory for the key string: the run is not rendered
+        if (!info->str)
+            continue;
+
         fill_composite_hash(&hk, info);
 
-        hv = ass_cache_get(render_priv->cache.composite_cache, &hk);
+        hv = ass_composite_cache_get(render_priv->cache.composite_cache, &hk);
 
         if(hv){
             info->bm = hv->bm;
             info->bm_o = hv->bm_o;
             info->bm_s = hv->bm_s;
             info->cached = 1;
-            free(info->str);
         }else{
             if(info->chars != 1 && !info->is_drawing){
                 info->bm = alloc_bitmap(info->w, info->h);
@@ -2435,7 +2887,8 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
         if (info->skip) continue;
         while (info) {
             current_info = &combined_info[info->bm_run_id];
-            if(!current_info->cached && !is_skip_symbol(info->symbol)){
+            if(!current_info->cached && current_info->str &&
+               !is_skip_symbol(info->symbol)){
                 if(current_info->chars == 1 || current_info->is_drawing){
                     int offset_x = (info->pos.x >> 6) - current_info->pos.x;
                     int offset_y = (info->pos.y >> 6) - current_info->pos.y;
@@ -2482,7 +2935,7 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
     }
 
     for (i = 0; i < nb_bitmaps; ++i) {
-        if(!combined_info[i].cached){
+        if(!combined_info[i].cached && combined_info[i].str){
             CompositeHashValue chv;
             CombinedBitmapInfo *info = &combined_info[i];
             if(info->bm || info->bm_o){
@@ -2491,12 +2944,15 @@ ass_render_event(ASS_Renderer *render_priv, ASS_Event *event,
             }
 
             fill_composite_hash(&hk, info);
+            // the key outlives the frame, so the string leaves the arena
+            hk.str = strdup(info->str);
 
             chv.bm = info->bm;
             chv.bm_o = info->bm_o;
             chv.bm_s = info->bm_s;
 
-            ass_cache_put(render_priv->cache.composite_cache, &hk, &chv);
+            ass_composite_cache_put(render_priv->cache.composite_cache, &hk,
+                                    &chv);
         }
     }
 
@@ -2534,10 +2990,195 @@ void ass_free_images(ASS_Image *img)
 }
 
 /**
- * \brief Check cache limits and reset cache if they are exceeded
+ * \brief Miss rate of a cache since the last call, in 1/1024 units.
+ * Misses only count if the cache is close to its limit or was flushed,
+ * otherwise a larger limit would not have avoided them.
+ */
+static unsigned capacity_miss_rate(Cache *cache, size_t limit,
+                                   unsigned *last_lookups,
+                                   unsigned *last_misses,
+                                   unsigned *last_flushes)
+{
+    ASS_CacheStats stats;
+    unsigned lookups, misses;
+    int flushed;
+
+    ass_cache_stats(cache, &stats);
+    lookups = stats.hits + stats.misses - *last_lookups;
+    misses = stats.misses - *last_misses;
+    flushed = stats.flushes != *last_flushes;
+    *last_lookups = stats.hits + stats.misses;
+    *last_misses = stats.misses;
+    *last_flushes = stats.flushes;
+
+    if (!lookups || (!flushed && stats.size < limit / 4 * 3))
+        return 0;
+    return (uint64_t) misses * 1024 / lookups;
+}
+
+/**
+ * \brief Shift the cache budget between the bitmap and composite caches.
+ * Every CACHE_ADAPT_INTERVAL frames, a sixteenth of the budget moves to
+ * the cache with the clearly higher capacity miss rate, as long as the
+ * other keeps at least an eighth.  Rates rather than miss counts are
+ * compared because the bitmap cache is looked up once per glyph and the
+ * composite cache once per run.
+ */
+static void adapt_cache_limits(CacheStore *cache)
+{
+    size_t step = cache->budget / 16;
+    size_t min_size = cache->budget / 8;
+    unsigned bitmap_rate, composite_rate;
+
+    if (++cache->adapt_frames < CACHE_ADAPT_INTERVAL)
+        return;
+    cache->adapt_frames = 0;
+
+    bitmap_rate = capacity_miss_rate(cache->bitmap_cache,
+            cache->bitmap_max_size, &cache->last_lookups[0],
+            &cache->last_misses[0], &cache->last_flushes[0]);
+    composite_rate = capacity_miss_rate(cache->composite_cache,
+            cache->composite_max_size, &cache->last_lookups[1],
+            &cache->last_misses[1], &cache->last_flushes[1]);
+
+    if (bitmap_rate > composite_rate + composite_rate / 4 + 16 &&
+        cache->composite_max_size >= min_size + step) {
+        cache->composite_max_size -= step;
+        cache->bitmap_max_size += step;
+    } else if (composite_rate > bitmap_rate + bitmap_rate / 4 + 16 &&
+               cache->bitmap_max_size >= min_size + step) {
+        cache->bitmap_max_size -= step;
+        cache->composite_max_size += step;
+    }
+}
+
+typedef struct {
+    ASS_Font *font;
+    int in_use;                 // selected in the previous frame
+} EvictionCandidate;
+
+typedef struct {
+    EvictionCandidate *items;
+    int n;
+    unsigned frame;             // the previous frame
+} FontList;
+
+static void list_font(void *key, void *value, void *priv)
+{
+    FontList *list = priv;
+    ASS_Font *font = value;
+    list->items[list->n].font = font;
+    list->items[list->n].in_use = font->last_used == list->frame;
+    list->n++;
+}
+
+/**
+ * \brief Eviction order: fonts not in use before those in use, fonts
+ * without cached glyphs before those with, least recently used first
+ */
+static int cmp_eviction(const void *a, const void *b)
+{
+    const EvictionCandidate *ca = a;
+    const EvictionCandidate *cb = b;
+    if (ca->in_use != cb->in_use)
+        return ca->in_use - cb->in_use;
+    if (!ca->font->refs != !cb->font->refs)
+        return ca->font->refs ? 1 : -1;
+    if (ca->font->last_used != cb->font->last_used)
+        return ca->font->last_used < cb->font->last_used ? -1 : 1;
+    return 0;
+}
+
+static void mark_evicted_outline(void *key, void *value, void *priv)
+{
+    OutlineHashKey *k = key;
+    if (k->type == OUTLINE_GLYPH && k->u.glyph.font->evicted)
+        ((OutlineHashValue *) value)->evicted = 1;
+}
+
+static int bitmap_evicted(void *key, void *value, void *priv)
+{
+    BitmapHashKey *k = key;
+    return k->type == BITMAP_OUTLINE && k->u.outline.outline->evicted;
+}
+
+static int outline_evicted(void *key, void *value, void *priv)
+{
+    return ((OutlineHashValue *) value)->evicted;
+}
+
+static int font_evicted(void *key, void *value, void *priv)
+{
+    return ((ASS_Font *) value)->evicted;
+}
+
+/**
+ * \brief Shrink the font cache to three quarters of its limit.  Fonts the
+ * previous frame did not select go first, and among them those that no
+ * glyph cache entry references.  Only for evicted fonts that are still
+ * referenced are the glyph metrics, kerning pairs, outlines and bitmaps
+ * derived from them removed.
+ */
+static void evict_fonts(ASS_Renderer *priv, CacheStore *cache)
+{
+    ASS_CacheStats stats;
+    FontList list;
+    int i, n_evict, referenced = 0;
+
+    ass_cache_stats(cache->font_cache, &stats);
+    list.items = malloc(stats.items * sizeof(*list.items));
+    if (!list.items)
+        return;
+    list.n = 0;
+    list.frame = cache->frames - 1;
+    ass_cache_foreach(cache->font_cache, list_font, &list);
+    qsort(list.items, list.n, sizeof(*list.items), cmp_eviction);
+
+    n_evict = list.n - (cache->font_max - cache->font_max / 4);
+    for (i = 0; i < n_evict; ++i) {
+        ASS_Font *font = list.items[i].font;
+        font->evicted = 1;
+        referenced |= font->refs;
+        if (font == priv->state.font) {
+            priv->state.font = NULL;
+            priv->state.reset_style = NULL;
+        }
+    }
+    free(list.items);
+
+    if (referenced) {
+        ass_shaper_evict_fonts(priv->shaper);
+        // bitmap keys reference outlines, so mark the outlines to remove
+        // and drop their bitmaps first
+        ass_cache_foreach(cache->outline_cache, mark_evicted_outline, NULL);
+        if (ass_cache_remove_if(cache->bitmap_cache, bitmap_evicted, NULL)) {
+            ass_free_images(priv->prev_images_root);
+            priv->prev_images_root = 0;
+            priv->cache_cleared = 1;
+        }
+        ass_cache_remove_if(cache->outline_cache, outline_evicted, NULL);
+    }
+    ass_cache_remove_if(cache->font_cache, font_evicted, NULL);
+}
+
+/**
+ * \brief Enforce cache limits.  Called at the start of a frame, so no
+ * cache entry is referenced by glyphs or images of the frame being
+ * rendered; the only long-lived references are the previous frame's
+ * images and the font kept by the simple event fast path, and both are
+ * dropped whenever the cache entries they point to are removed.
  */
 static void check_cache_limits(ASS_Renderer *priv, CacheStore *cache)
 {
+    ASS_CacheStats stats;
+
+    cache->frames++;
+    if (cache->budget)
+        adapt_cache_limits(cache);
+    ass_cache_stats(cache->font_cache, &stats);
+    if (stats.items > cache->font_max)
+        evict_fonts(priv, cache);
+    ass_shaper_empty_cache(priv->shaper, cache->metrics_max);
     if (ass_cache_empty(cache->bitmap_cache, cache->bitmap_max_size)) {
         ass_free_images(priv->prev_images_root);
         priv->prev_images_root = 0;
@@ -2558,12 +3199,15 @@ static void check_cache_limits(ASS_Renderer *priv, CacheStore *cache)
 
 /**
  * \brief Start a new frame
+ * \param tracks tracks that will be rendered in this frame
+ * \param n_tracks number of tracks
  */
 static int
-ass_start_frame(ASS_Renderer *render_priv, ASS_Track *track,
+ass_start_frame(ASS_Renderer *render_priv, ASS_Track **tracks, int n_tracks,
                 long long now)
 {
     ASS_Settings *settings_priv = &render_priv->settings;
+    int i, n_events = 0;
 
     if (!render_priv->settings.frame_width
         && !render_priv->settings.frame_height)
@@ -2573,13 +3217,53 @@ ass_start_frame(ASS_Renderer *render_priv, ASS_Track *track,
         return 1;
 
     free_list_clear(render_priv);
+    ass_arena_reset(&render_priv->arena);
 
-    if (track->n_events == 0)
+    for (i = 0; i < n_tracks; ++i) {
+        ass_process_chunk_queue(tracks[i]);
+        n_events += tracks[i]->n_events;
+    }
+    if (n_events == 0)
         return 1;               // nothing to do
 
-    render_priv->track = track;
     render_priv->time = now;
 
+    // PAR correction
+    double par = render_priv->settings.par;
+    if (par == 0.) {
+        if (settings_priv->frame_width && settings_priv->frame_height &&
+            settings_priv->storage_width && settings_priv->storage_height) {
+            double dar = ((double) settings_priv->frame_width) /
+                         settings_priv->frame_height;
+            double sar = ((double) settings_priv->storage_width) /
+                         settings_priv->storage_height;
+            par = sar / dar;
+        } else
+            par = 1.0;
+    }
+    render_priv->font_scale_x = par;
+
+    render_priv->prev_images_root = render_priv->images_root;
+    render_priv->images_root = 0;
+
+    check_cache_limits(render_priv, &render_priv->cache);
+
+    return 0;
+}
+
+/**
+ * \brief Set up track-dependent state before rendering events of a track
+ */
+static void ass_start_track(ASS_Renderer *render_priv, ASS_Track *track)
+{
+    ASS_Settings *settings_priv = &render_priv->settings;
+    double font_scale = render_priv->font_scale;
+    double border_scale = render_priv->border_scale;
+
+    if (render_priv->track != track)
+        render_priv->state.reset_style = NULL;
+    render_priv->track = track;
+
     ass_lazy_track_init(render_priv->library, render_priv->track);
 
     render_priv->font_scale = settings_priv->font_size_coeff *
@@ -2599,31 +3283,14 @@ ass_start_frame(ASS_Renderer *render_priv, ASS_Track *track,
         render_priv->blur_scale = render_priv->border_scale;
     render_priv->border_scale *= settings_priv->font_size_coeff;
 
+    // the cached context reset depends on font and border scale
+    if (render_priv->font_scale != font_scale ||
+        render_priv->border_scale != border_scale)
+        render_priv->state.reset_style = NULL;
+
     ass_shaper_set_kerning(render_priv->shaper, track->Kerning);
     ass_shaper_set_language(render_priv->shaper, track->Language);
     ass_shaper_set_level(render_priv->shaper, render_priv->settings.shaper);
-
-    // PAR correction
-    double par = render_priv->settings.par;
-    if (par == 0.) {
-        if (settings_priv->frame_width && settings_priv->frame_height &&
-            settings_priv->storage_width && settings_priv->storage_height) {
-            double dar = ((double) settings_priv->frame_width) /
-                         settings_priv->frame_height;
-            double sar = ((double) settings_priv->storage_width) /
-                         settings_priv->storage_height;
-            par = sar / dar;
-        } else
-            par = 1.0;
-    }
-    render_priv->font_scale_x = par;
-
-    render_priv->prev_images_root = render_priv->images_root;
-    render_priv->images_root = 0;
-
-    check_cache_limits(render_priv, &render_priv->cache);
-
-    return 0;
 }
 
 static int cmp_event_layer(const void *p1, const void *p2)
@@ -2634,6 +3301,8 @@ static int cmp_event_layer(const void *p1, const void *p2)
         return -1;
     if (e1->Layer > e2->Layer)
         return 1;
+    if (((EventImages *) p1)->track != ((EventImages *) p2)->track)
+        return ((EventImages *) p1)->track - ((EventImages *) p2)->track;
     if (e1->ReadOrder < e2->ReadOrder)
         return -1;
     if (e1->ReadOrder > e2->ReadOrder)
@@ -2644,14 +3313,17 @@ static int cmp_event_layer(const void *p1, const void *p2)
 static ASS_RenderPriv *get_render_priv(ASS_Renderer *render_priv,
                                        ASS_Event *event)
 {
-    if (!event->render_priv)
-        event->render_priv = calloc(1, sizeof(ASS_RenderPriv));
-    if (render_priv->render_id != event->render_priv->render_id) {
-        memset(event->render_priv, 0, sizeof(ASS_RenderPriv));
-        event->render_priv->render_id = render_priv->render_id;
+    ASS_RenderPriv *priv = event->render_priv;
+
+    if (!priv)
+        priv = event->render_priv = calloc(1, sizeof(ASS_RenderPriv));
+    if (render_priv->render_id != priv->render_id) {
+        // keep the decoded text
+        priv->top = priv->height = priv->left = priv->width = 0;
+        priv->render_id = render_priv->render_id;
     }
 
-    return event->render_priv;
+    return priv;
 }
 
 static int overlap(Segment *s1, Segment *s2)
@@ -2662,9 +3334,65 @@ static int overlap(Segment *s1, Segment *s2)
     return 1;
 }
 
-static int cmp_segment(const void *p1, const void *p2)
+/**
+ * \brief Collision segments, sorted by top coordinate
+ * The height of the tallest segment bounds how far above a tested
+ * segment an overlapping one can start, so scans begin at a position
+ * found by binary search instead of at the first segment.
+ */
+typedef struct {
+    Segment *segs;
+    int cnt;
+    int max_height;
+} SegmentList;
+
+/**
+ * \brief Find the first segment starting below a coordinate
+ * \return index of the first segment with top > y, or cnt
+ */
+static int segment_upper_bound(SegmentList *used, int y)
+{
+    int lo = 0, hi = used->cnt;
+
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (used->segs[mid].a <= y)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * \brief Insert a segment, keeping the list sorted
+ * O(log n) to find the position plus a memmove of the tail.
+ */
+static void insert_segment(SegmentList *used, Segment *s)
+{
+    int pos = segment_upper_bound(used, s->a);
+
+    memmove(used->segs + pos + 1, used->segs + pos,
+            (used->cnt - pos) * sizeof(Segment));
+    used->segs[pos] = *s;
+    used->cnt++;
+    used->max_height = FFMAX(used->max_height, s->b - s->a);
+}
+
+/**
+ * \brief Check whether a segment overlaps any segment of the list
+ * O(log n + k), k being the number of segments starting less than
+ * max_height above the tested one and above its bottom.
+ */
+static int overlap_any(Segment *s, SegmentList *used)
 {
-    return ((Segment *) p1)->a - ((Segment *) p2)->a;
+    int i;
+
+    for (i = segment_upper_bound(used, s->a - used->max_height);
+         i < used->cnt && used->segs[i].a < s->b; ++i)
+        if (overlap(s, used->segs + i))
+            return 1;
+    return 0;
 }
 
 static void
@@ -2695,31 +3423,43 @@ shift_event(ASS_Renderer *render_priv, EventImages *ei, int shift)
 
 // dir: 1 - move down
 //      -1 - move up
-static int fit_segment(Segment *s, Segment *fixed, int *cnt, int dir)
+// The fitted segment is inserted into the list. Both directions only
+// visit segments that can still collide as the shift grows: O(log n + k)
+// plus the insertion, k being the number of segments in that window.
+static int fit_segment(Segment *s, SegmentList *used, int dir)
 {
+    Segment *fixed = used->segs;
     int i;
     int shift = 0;
+    Segment fitted;
 
     if (dir == 1)               // move down
-        for (i = 0; i < *cnt; ++i) {
-            if (s->b + shift <= fixed[i].a || s->a + shift >= fixed[i].b ||
+        for (i = segment_upper_bound(used, s->a - used->max_height);
+             i < used->cnt; ++i) {
+            // shift only grows, so no later segment can overlap either
+            if (s->b + shift <= fixed[i].a)
+                break;
+            if (s->a + shift >= fixed[i].b ||
                 s->hb <= fixed[i].ha || s->ha >= fixed[i].hb)
                 continue;
             shift = fixed[i].b - s->a;
     } else                      // dir == -1, move up
-        for (i = *cnt - 1; i >= 0; --i) {
+        for (i = segment_upper_bound(used, s->b - 1) - 1; i >= 0; --i) {
+            // all remaining segments end above the shifted one, and
+            // the shift only changes on an overlap
+            if (fixed[i].a + used->max_height <= s->a + shift)
+                break;
             if (s->b + shift <= fixed[i].a || s->a + shift >= fixed[i].b ||
                 s->hb <= fixed[i].ha || s->ha >= fixed[i].hb)
                 continue;
             shift = fixed[i].a - s->b;
         }
 
-    fixed[*cnt].a = s->a + shift;
-    fixed[*cnt].b = s->b + shift;
-    fixed[*cnt].ha = s->ha;
-    fixed[*cnt].hb = s->hb;
-    (*cnt)++;
-    qsort(fixed, *cnt, sizeof(Segment), cmp_segment);
+    fitted.a = s->a + shift;
+    fitted.b = s->b + shift;
+    fitted.ha = s->ha;
+    fitted.hb = s->hb;
+    insert_segment(used, &fitted);
 
     return shift;
 }
@@ -2727,9 +3467,12 @@ static int fit_segment(Segment *s, Segment *fixed, int *cnt, int dir)
 static void
 fix_collisions(ASS_Renderer *render_priv, EventImages *imgs, int cnt)
 {
-    Segment *used = malloc(cnt * sizeof(*used));
-    int cnt_used = 0;
-    int i, j;
+    SegmentList used;
+    int i;
+
+    used.segs = malloc(cnt * sizeof(*used.segs));
+    used.cnt = 0;
+    used.max_height = 0;
 
     // fill used[] with fixed events
     for (i = 0; i < cnt; ++i) {
@@ -2751,24 +3494,18 @@ fix_collisions(ASS_Renderer *render_priv, EventImages *imgs, int cnt)
                 priv->left = 0;
                 priv->width = 0;
             }
-            for (j = 0; j < cnt_used; ++j)
-                if (overlap(&s, used + j)) {    // no, it's not
-                    priv->top = 0;
-                    priv->height = 0;
-                    priv->left = 0;
-                    priv->width = 0;
-                }
+            if (overlap_any(&s, &used)) {      // no, it's not
+                priv->top = 0;
+                priv->height = 0;
+                priv->left = 0;
+                priv->width = 0;
+            }
             if (priv->height > 0) {     // still a fixed event
-                used[cnt_used].a = priv->top;
-                used[cnt_used].b = priv->top + priv->height;
-                used[cnt_used].ha = priv->left;
-                used[cnt_used].hb = priv->left + priv->width;
-                cnt_used++;
+                insert_segment(&used, &s);
                 shift_event(render_priv, imgs + i, priv->top - imgs[i].top);
             }
         }
     }
-    qsort(used, cnt_used, sizeof(Segment), cmp_segment);
 
     // try to fit other events in free spaces
     for (i = 0; i < cnt; ++i) {
@@ -2783,7 +3520,7 @@ fix_collisions(ASS_Renderer *render_priv, EventImages *imgs, int cnt)
             s.b = imgs[i].top + imgs[i].height;
             s.ha = imgs[i].left;
             s.hb = imgs[i].left + imgs[i].width;
-            shift = fit_segment(&s, used, &cnt_used, imgs[i].shift_direction);
+            shift = fit_segment(&s, &used, imgs[i].shift_direction);
             if (shift)
                 shift_event(render_priv, imgs + i, shift);
             // make it fixed
@@ -2795,7 +3532,7 @@ fix_collisions(ASS_Renderer *render_priv, EventImages *imgs, int cnt)
 
     }
 
-    free(used);
+    free(used.segs);
 }
 
 /**
@@ -2864,23 +3601,37 @@ static int ass_detect_change(ASS_Renderer *priv)
 }
 
 /**
- * \brief render a frame
- * \param priv library handle
- * \param track track
- * \param now current video timestamp (ms)
- * \param detect_change a value describing how the new images differ from the previous ones will be written here:
- *        0 if identical, 1 if different positions, 2 if different content.
- *        Can be NULL, in that case no detection is performed.
+ * \brief Clip an image to a rectangle
+ * \return 0 if nothing of the image is left
  */
-ASS_Image *ass_render_frame(ASS_Renderer *priv, ASS_Track *track,
-                            long long now, int *detect_change)
+static int clip_image(ASS_Image *img, Rect *r)
 {
-    int i, cnt, rc;
+    int x0 = FFMAX(img->dst_x, r->x0);
+    int y0 = FFMAX(img->dst_y, r->y0);
+    int x1 = FFMIN(img->dst_x + img->w, r->x1);
+    int y1 = FFMIN(img->dst_y + img->h, r->y1);
+
+    if (x0 >= x1 || y0 >= y1)
+        return 0;
+
+    img->bitmap += (y0 - img->dst_y) * img->stride + (x0 - img->dst_x);
+    img->w = x1 - x0;
+    img->h = y1 - y0;
+    img->dst_x = x0;
+    img->dst_y = y0;
+    return 1;
+}
+
+static ASS_Image *render_frame(ASS_Renderer *priv, ASS_Track **tracks,
+                               int n_tracks, long long now,
+                               int *detect_change)
+{
+    int i, t, cnt, rc;
     EventImages *last;
     ASS_Image **tail;
 
     // init frame
-    rc = ass_start_frame(priv, track, now);
+    rc = ass_start_frame(priv, tracks, n_tracks, now);
     if (rc != 0) {
         if (detect_change) {
             *detect_change = 2;
@@ -2890,19 +3641,25 @@ ASS_Image *ass_render_frame(ASS_Renderer *priv, ASS_Track *track,
 
     // render events separately
     cnt = 0;
-    for (i = 0; i < track->n_events; ++i) {
-        ASS_Event *event = track->events + i;
-        if ((event->Start <= now)
-            && (now < (event->Start + event->Duration))) {
-            if (cnt >= priv->eimg_size) {
-                priv->eimg_size += 100;
-                priv->eimg =
-                    realloc(priv->eimg,
-                            priv->eimg_size * sizeof(EventImages));
+    for (t = 0; t < n_tracks; ++t) {
+        ASS_Track *track = tracks[t];
+        if (track->n_events == 0)
+            continue;
+        ass_start_track(priv, track);
+        for (i = 0; i < track->n_events; ++i) {
+            ASS_Event *event = track->events + i;
+            if ((event->Start <= now)
+                && (now < (event->Start + event->Duration))) {
+                if (cnt >= priv->eimg_size) {
+                    priv->eimg_size += 100;
+                    priv->eimg =
+                        realloc(priv->eimg,
+                                priv->eimg_size * sizeof(EventImages));
+                }
+                rc = ass_render_event(priv, event, priv->eimg + cnt);
+                if (!rc)
+                    priv->eimg[cnt++].track = t;
             }
-            rc = ass_render_event(priv, event, priv->eimg + cnt);
-            if (!rc)
-                ++cnt;
         }
     }
 
@@ -2924,11 +3681,18 @@ ASS_Image *ass_render_frame(ASS_Renderer *priv, ASS_Track *track,
     for (i = 0; i < cnt; ++i) {
         ASS_Image *cur = priv->eimg[i].imgs;
         while (cur) {
+            ASS_Image *next = cur->next;
+            if (priv->use_roi && !clip_image(cur, &priv->roi)) {
+                free(cur);
+                cur = next;
+                continue;
+            }
             *tail = cur;
             tail = &cur->next;
-            cur = cur->next;
+            cur = next;
         }
     }
+    *tail = 0;
 
     if (detect_change)
         *detect_change = ass_detect_change(priv);
@@ -2940,3 +3704,62 @@ ASS_Image *ass_render_frame(ASS_Renderer *priv, ASS_Track *track,
 
     return priv->images_root;
 }
+
+/**
+ * \brief render a frame from several tracks
+ * \param priv library handle
+ * \param tracks tracks, from bottom to top
+ * \param n_tracks number of tracks
+ * \param now current video timestamp (ms)
+ * \param detect_change a value describing how the new images differ from the previous ones will be written here:
+ *        0 if identical, 1 if different positions, 2 if different content.
+ *        Can be NULL, in that case no detection is performed.
+ */
+ASS_Image *ass_render_frame_multi(ASS_Renderer *priv, ASS_Track **tracks,
+                                  int n_tracks, long long now,
+                                  int *detect_change)
+{
+    ASS_Image *img;
+
+    // keep a running font prefetch away from the fonts until we are done
+    ass_prefetch_lock(priv->prefetch);
+    img = render_frame(priv, tracks, n_tracks, now, detect_change);
+    ass_prefetch_unlock(priv->prefetch);
+
+    return img;
+}
+
+/**
+ * \brief render a frame
+ * \param priv library handle
+ * \param track track
+ * \param now current video timestamp (ms)
+ * \param detect_change see ass_render_frame_multi
+ */
+ASS_Image *ass_render_frame(ASS_Renderer *priv, ASS_Track *track,
+                            long long now, int *detect_change)
+{
+    return ass_render_frame_multi(priv, &track, 1, now, detect_change);
+}
+
+/**
+ * \brief render the part of a frame inside a rectangle
+ * Like ass_render_frame, but events and glyphs that cannot be seen in the
+ * rectangle are not rasterized, and all images are clipped to it.
+ */
+ASS_Image *ass_render_frame_roi(ASS_Renderer *priv, ASS_Track *track,
+                                long long now, int *detect_change,
+                                int x0, int y0, int x1, int y1)
+{
+    ASS_Image *img;
+
+    priv->use_roi = 1;
+    priv->roi.x0 = x0;
+    priv->roi.y0 = y0;
+    priv->roi.x1 = x1;
+    priv->roi.y1 = y1;
+    img = ass_render_frame(priv, track, now, detect_change);
+    priv->use_roi = 0;
+
+    return img;
+}
@@ -42,10 +42,16 @@ typedef struct ass_shaper ASS_Shaper;
 #include "ass_library.h"
 #include "ass_drawing.h"
 #include "ass_bitmap.h"
+#include "ass_prefetch.h"
+#include "ass_text.h"
 
 #define GLYPH_CACHE_MAX 10000
 #define BITMAP_CACHE_MAX_SIZE 500 * 1048576
 #define COMPOSITE_CACHE_MAX_SIZE 500 * 1048576
+#define FONT_CACHE_MAX 1000
+#define WORKER_AUTO_MAX_THREADS 8  // limit for ass_set_threads(priv, 0)
+#define CACHE_ADAPT_INTERVAL 64  // frames between cache budget adjustments
+#define GLYPH_METRICS_CACHE_MAX 20000
 
 #define PARSED_FADE (1<<0)
 #define PARSED_A    (1<<1)
@@ -95,6 +101,7 @@ typedef struct {
     int top, height, left, width;
     int detect_collisions;
     int shift_direction;
+    int track;                  // index of the event's track in this frame
     ASS_Event *event;
 } EventImages;
 
@@ -152,8 +159,25 @@ typedef struct {
 // describes a glyph
 // GlyphInfo and TextInfo are used for text centering and word-wrapping operations
 typedef struct glyph_info {
+    // Fields read by the per-glyph layout passes (measuring, wrapping,
+    // positioning, bbox) come first, so these passes only touch the first
+    // couple of cache lines of each glyph.
     unsigned symbol;
     unsigned skip;              // skip glyph when layouting text
+    int asc, desc;              // font max ascender and descender
+    FT_Vector pos;
+    FT_Vector cluster_advance;
+    char linebreak;             // the first (leading) glyph of some line ?
+    char effect;                // the first (leading) glyph of some effect ?
+    // next glyph in this cluster
+    struct glyph_info *next;
+    FT_Vector advance;          // 26.6
+    FT_Vector offset;
+    FT_BBox bbox;
+    double fax, fay;            // text shearing
+    double scale_x, scale_y;
+
+    // everything else is only needed for shaping and rasterization
     ASS_Font *font;
     int face_index;
     int glyph_index;
@@ -169,27 +193,17 @@ typedef struct glyph_info {
     Bitmap *bm;                 // glyph bitmap
     Bitmap *bm_o;               // outline bitmap
     Bitmap *bm_s;               // shadow bitmap
-    FT_BBox bbox;
-    FT_Vector pos;
-    FT_Vector offset;
-    char linebreak;             // the first (leading) glyph of some line ?
     uint32_t c[4];              // colors
-    FT_Vector advance;          // 26.6
-    FT_Vector cluster_advance;
-    char effect;                // the first (leading) glyph of some effect ?
     Effect effect_type;
     int effect_timing;          // time duration of current karaoke word
     // after process_karaoke_effects: distance in pixels from the glyph origin.
     // part of the glyph to the left of it is displayed in a different color.
     int effect_skip_timing;     // delay after the end of last karaoke word
-    int asc, desc;              // font max ascender and descender
     int be;                     // blur edges
     double blur;                // gaussian blur
     double shadow_x;
     double shadow_y;
     double frx, fry, frz;       // rotation
-    double fax, fay;            // text shearing
-    double scale_x, scale_y;
     double orig_scale_x, orig_scale_y; // scale_x,y before fix_glyph_scaling
     int border_style;
     double border_x, border_y;
@@ -202,9 +216,6 @@ typedef struct glyph_info {
     int shape_run_id;
 
     BitmapHashKey hash_key;
-
-    // next glyph in this cluster
-    struct glyph_info *next;
 } GlyphInfo;
 
 typedef struct {
@@ -231,6 +242,9 @@ typedef struct {
     ASS_Event *event;
     ASS_Style *style;
     int parsed_tags;
+    ASS_Style *reset_style;     // context is an untouched reset to this style
+    int reset_n_styles;         // track->n_styles when reset_style was set
+    uint64_t reset_hash;        // style_reset_hash of reset_style back then
 
     ASS_Font *font;
     double font_size;
@@ -302,6 +316,18 @@ typedef struct {
     size_t glyph_max;
     size_t bitmap_max_size;
     size_t composite_max_size;
+    size_t font_max;
+    size_t metrics_max;
+    unsigned frames;            // frames started, stamps ASS_Font.last_used
+
+    // adaptive sizing of the bitmap and composite caches
+    size_t budget;              // total size of both, 0 = fixed limits
+    size_t fixed_bitmap_max;    // limits to restore when the budget is
+    size_t fixed_composite_max; // removed
+    int adapt_frames;           // frames since the last adjustment
+    unsigned last_lookups[2];   // bitmap, composite counters back then
+    unsigned last_misses[2];
+    unsigned last_flushes[2];
 } CacheStore;
 
 typedef void (*BitmapBlendFunc)(uint8_t *dst, intptr_t dst_stride,
@@ -318,6 +344,13 @@ typedef void (*RestrideBitmapFunc)(uint8_t *dst, intptr_t dst_stride,
                                    uint8_t *src, intptr_t src_stride,
                                    intptr_t width, intptr_t height);
 
+typedef struct {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+} Rect;
+
 struct ass_renderer {
     ASS_Library *library;
     FT_Library ftlibrary;
@@ -326,6 +359,10 @@ struct ass_renderer {
     int render_id;
     ASS_SynthPriv *synth_priv;
     ASS_Shaper *shaper;
+    ASS_WorkerPool *workers;    // started on first use, see get_worker_pool
+    int workers_init;
+    int n_threads;              // 1 by default, 0 = one per CPU
+    ASS_Prefetch *prefetch;     // background font loading, if started
 
     ASS_Image *images_root;     // rendering result is stored here
     ASS_Image *prev_images_root;
@@ -333,6 +370,8 @@ struct ass_renderer {
 
     EventImages *eimg;          // temporary buffer for sorting rendered events
     int eimg_size;              // allocated buffer size
+    int use_roi;                // only render what is visible in roi
+    Rect roi;                   // region of interest (screen coordinates)
 
     // frame-global data
     int width, height;          // screen dimensions
@@ -359,19 +398,9 @@ struct ass_renderer {
 
     FreeList *free_head;
     FreeList *free_tail;
-};
-
-typedef struct render_priv {
-    int top, height, left, width;
-    int render_id;
-} RenderPriv;
 
-typedef struct {
-    int x0;
-    int y0;
-    int x1;
-    int y1;
-} Rect;
+    Arena arena;                // scratch memory, reset every frame
+};
 
 typedef struct {
     int a, b;                   // top and height
@@ -19,12 +19,14 @@
 
 #include "config.h"
 #include "ass_render.h"
+#include "ass_shaper.h"
 
 static void ass_reconfigure(ASS_Renderer *priv)
 {
     ASS_Settings *settings = &priv->settings;
 
     priv->render_id++;
+    priv->state.reset_style = NULL;
     ass_cache_empty(priv->cache.outline_cache, 0);
     ass_cache_empty(priv->cache.bitmap_cache, 0);
     ass_cache_empty(priv->cache.composite_cache, 0);
@@ -144,22 +146,114 @@ void ass_set_fonts(ASS_Renderer *priv, const char *default_font,
     priv->settings.default_family =
         default_family ? strdup(default_family) : 0;
 
+    ass_prefetch_lock(priv->prefetch);
     if (priv->fontconfig_priv)
         fontconfig_done(priv->fontconfig_priv);
     priv->fontconfig_priv =
         fontconfig_init(priv->library, priv->ftlibrary, default_family,
                         default_font, fc, config, update);
+    ass_prefetch_unlock(priv->prefetch);
 }
 
 int ass_fonts_update(ASS_Renderer *render_priv)
 {
-    return fontconfig_update(render_priv->fontconfig_priv);
+    int ret;
+    ass_prefetch_lock(render_priv->prefetch);
+    ret = fontconfig_update(render_priv->fontconfig_priv);
+    ass_prefetch_unlock(render_priv->prefetch);
+    return ret;
 }
 
 void ass_set_cache_limits(ASS_Renderer *render_priv, int glyph_max,
                           int bitmap_max)
 {
-    render_priv->cache.glyph_max = glyph_max ? glyph_max : GLYPH_CACHE_MAX;
-    render_priv->cache.bitmap_max_size = bitmap_max ? 1048576 * bitmap_max :
-                                         BITMAP_CACHE_MAX_SIZE;
+    CacheStore *cache = &render_priv->cache;
+    size_t bitmap_max_size = bitmap_max ?
+        1048576 * (size_t) bitmap_max : BITMAP_CACHE_MAX_SIZE;
+
+    cache->glyph_max = glyph_max ? glyph_max : GLYPH_CACHE_MAX;
+    // the cache budget, if any, manages the bitmap cache size until it
+    // is removed
+    if (cache->budget)
+        cache->fixed_bitmap_max = bitmap_max_size;
+    else
+        cache->bitmap_max_size = bitmap_max_size;
+}
+
+void ass_set_cache_budget(ASS_Renderer *priv, int budget_mb)
+{
+    CacheStore *cache = &priv->cache;
+
+    if (budget_mb <= 0) {
+        if (cache->budget) {
+            cache->budget = 0;
+            cache->bitmap_max_size = cache->fixed_bitmap_max;
+            cache->composite_max_size = cache->fixed_composite_max;
+        }
+        return;
+    }
+
+    if (!cache->budget) {
+        cache->fixed_bitmap_max = cache->bitmap_max_size;
+        cache->fixed_composite_max = cache->composite_max_size;
+    }
+    // start with an even split
+    cache->budget = (size_t) budget_mb * 1048576;
+    cache->bitmap_max_size = cache->budget / 2;
+    cache->composite_max_size = cache->budget - cache->bitmap_max_size;
+    cache->adapt_frames = 0;
+}
+
+int ass_get_cache_stats(ASS_Renderer *priv, ASS_CacheType type,
+                        ASS_CacheStats *stats)
+{
+    CacheStore *cache = &priv->cache;
+
+    switch (type) {
+    case ASS_CACHE_FONT:
+        ass_prefetch_lock(priv->prefetch);
+        ass_cache_stats(cache->font_cache, stats);
+        ass_prefetch_unlock(priv->prefetch);
+        stats->limit = cache->font_max;
+        return 0;
+    case ASS_CACHE_OUTLINE:
+        ass_cache_stats(cache->outline_cache, stats);
+        stats->limit = cache->glyph_max;
+        return 0;
+    case ASS_CACHE_BITMAP:
+        ass_cache_stats(cache->bitmap_cache, stats);
+        stats->limit = cache->bitmap_max_size;
+        return 0;
+    case ASS_CACHE_COMPOSITE:
+        ass_cache_stats(cache->composite_cache, stats);
+        stats->limit = cache->composite_max_size;
+        return 0;
+    case ASS_CACHE_GLYPH_METRICS:
+    case ASS_CACHE_KERNING:
+        if (ass_shaper_cache_stats(priv->shaper, type, stats) < 0)
+            return -1;
+        stats->limit = cache->metrics_max;
+        return 0;
+    }
+    return -1;
+}
+
+void ass_set_threads(ASS_Renderer *priv, int n_threads)
+{
+    if (n_threads < 0)
+        n_threads = 0;
+    if (priv->n_threads == n_threads)
+        return;
+    priv->n_threads = n_threads;
+    ass_worker_pool_free(priv->workers);
+    priv->workers = NULL;
+    priv->workers_init = 0;
+}
+
+void ass_set_font_cache_limits(ASS_Renderer *render_priv, int font_max,
+                               int glyph_metrics_max)
+{
+    render_priv->cache.font_max = font_max ? font_max : FONT_CACHE_MAX;
+    render_priv->cache.metrics_max = glyph_metrics_max ? glyph_metrics_max :
+                                     GLYPH_METRICS_CACHE_MAX;
 }
@@ -46,8 +46,12 @@ struct ass_shaper {
     FriBidiCharType *ctypes;
     FriBidiLevel *emblevels;
     FriBidiStrIndex *cmap;
+    FriBidiJoiningType *joins;
     FriBidiParType base_direction;
 
+    // Kerning pair cache, shared by all fonts
+    Cache *kerning_cache;
+
 #ifdef CONFIG_HARFBUZZ
     // OpenType features
     int n_features;
@@ -56,19 +60,27 @@ struct ass_shaper {
 
     // Glyph metrics cache, to speed up shaping
     Cache *metrics_cache;
+
+    // Reused for every shape run and shared by all HarfBuzz fonts
+    hb_buffer_t *buf;
+    hb_font_funcs_t *font_funcs;
 #endif
 };
 
 #ifdef CONFIG_HARFBUZZ
 struct ass_shaper_metrics_data {
+    FT_Face face;
     Cache *metrics_cache;
+    Cache *kerning_cache;
     GlyphMetricsHashKey hash_key;
     int vertical;
+    // scale and ppem last given to the HarfBuzz font
+    FT_Fixed x_scale, y_scale;
+    FT_UShort x_ppem, y_ppem;
 };
 
 struct ass_shaper_font_data {
     hb_font_t *fonts[ASS_FONT_MAX_FACES];
-    hb_font_funcs_t *font_funcs[ASS_FONT_MAX_FACES];
     struct ass_shaper_metrics_data *metrics_data[ASS_FONT_MAX_FACES];
 };
 #endif
@@ -97,6 +109,8 @@ static void check_allocations(ASS_Shaper *shaper, size_t new_size)
         shaper->ctypes     = realloc(shaper->ctypes, sizeof(FriBidiCharType) * new_size);
         shaper->emblevels  = realloc(shaper->emblevels, sizeof(FriBidiLevel) * new_size);
         shaper->cmap       = realloc(shaper->cmap, sizeof(FriBidiStrIndex) * new_size);
+        shaper->joins      = realloc(shaper->joins, sizeof(FriBidiJoiningType) * new_size);
+        shaper->n_glyphs   = new_size;
     }
 }
 
@@ -105,14 +119,20 @@ static void check_allocations(ASS_Shaper *shaper, size_t new_size)
  */
 void ass_shaper_free(ASS_Shaper *shaper)
 {
+    ass_cache_done(shaper->kerning_cache);
 #ifdef CONFIG_HARFBUZZ
     ass_cache_done(shaper->metrics_cache);
     free(shaper->features);
+    hb_buffer_destroy(shaper->buf);
+    // fonts still alive hold their own reference
+    if (shaper->font_funcs)
+        hb_font_funcs_destroy(shaper->font_funcs);
 #endif
     free(shaper->event_text);
     free(shaper->ctypes);
     free(shaper->emblevels);
     free(shaper->cmap);
+    free(shaper->joins);
     free(shaper);
 }
 
@@ -122,9 +142,8 @@ void ass_shaper_font_data_free(ASS_ShaperFontData *priv)
     int i;
     for (i = 0; i < ASS_FONT_MAX_FACES; i++)
         if (priv->fonts[i]) {
-            free(priv->metrics_data[i]);
             hb_font_destroy(priv->fonts[i]);
-            hb_font_funcs_destroy(priv->font_funcs[i]);
+            free(priv->metrics_data[i]);
         }
     free(priv);
 #endif
@@ -171,17 +190,30 @@ static void set_run_features(ASS_Shaper *shaper, GlyphInfo *info)
 }
 
 /**
- * \brief Update HarfBuzz's idea of font metrics
+ * \brief Update HarfBuzz's idea of font metrics, if the face size changed
+ * since the last call
  * \param hb_font HarfBuzz font
- * \param face associated FreeType font face
+ * \param metrics metrics data of the font, remembers the last size
  */
-static void update_hb_size(hb_font_t *hb_font, FT_Face face)
+static void update_hb_size(hb_font_t *hb_font,
+                           struct ass_shaper_metrics_data *metrics)
 {
+    FT_Face face = metrics->face;
+    FT_Size_Metrics *m = &face->size->metrics;
+
+    if (m->x_scale == metrics->x_scale && m->y_scale == metrics->y_scale &&
+            m->x_ppem == metrics->x_ppem && m->y_ppem == metrics->y_ppem)
+        return;
+
     hb_font_set_scale (hb_font,
-            ((uint64_t) face->size->metrics.x_scale * (uint64_t) face->units_per_EM) >> 16,
-            ((uint64_t) face->size->metrics.y_scale * (uint64_t) face->units_per_EM) >> 16);
-    hb_font_set_ppem (hb_font, face->size->metrics.x_ppem,
-            face->size->metrics.y_ppem);
+            ((uint64_t) m->x_scale * (uint64_t) face->units_per_EM) >> 16,
+            ((uint64_t) m->y_scale * (uint64_t) face->units_per_EM) >> 16);
+    hb_font_set_ppem (hb_font, m->x_ppem, m->y_ppem);
+
+    metrics->x_scale = m->x_scale;
+    metrics->y_scale = m->y_scale;
+    metrics->x_ppem = m->x_ppem;
+    metrics->y_ppem = m->y_ppem;
 }
 
 
@@ -201,7 +233,8 @@ get_cached_metrics(struct ass_shaper_metrics_data *metrics, FT_Face face,
     GlyphMetricsHashValue *val;
 
     metrics->hash_key.glyph_index = glyph;
-    val = ass_cache_get(metrics->metrics_cache, &metrics->hash_key);
+    val = ass_glyph_metrics_cache_get(metrics->metrics_cache,
+                                      &metrics->hash_key);
 
     if (!val) {
         int load_flags = FT_LOAD_DEFAULT | FT_LOAD_IGNORE_GLOBAL_ADVANCE_WIDTH
@@ -218,7 +251,8 @@ get_cached_metrics(struct ass_shaper_metrics_data *metrics, FT_Face face,
         if (metrics->vertical && unicode >= VERTICAL_LOWER_BOUND)
             new_val.metrics.horiAdvance = new_val.metrics.vertAdvance;
 
-        val = ass_cache_put(metrics->metrics_cache, &metrics->hash_key, &new_val);
+        val = ass_glyph_metrics_cache_put(metrics->metrics_cache,
+                                          &metrics->hash_key, &new_val);
     }
 
     return val;
@@ -228,8 +262,8 @@ static hb_bool_t
 get_glyph(hb_font_t *font, void *font_data, hb_codepoint_t unicode,
           hb_codepoint_t variation, hb_codepoint_t *glyph, void *user_data)
 {
-    FT_Face face = font_data;
-    struct ass_shaper_metrics_data *metrics_priv = user_data;
+    struct ass_shaper_metrics_data *metrics_priv = font_data;
+    FT_Face face = metrics_priv->face;
 
     if (variation)
         *glyph = FT_Face_GetCharVariantIndex(face, ass_font_index_magic(face, unicode), variation);
@@ -247,8 +281,8 @@ static hb_position_t
 cached_h_advance(hb_font_t *font, void *font_data, hb_codepoint_t glyph,
                  void *user_data)
 {
-    FT_Face face = font_data;
-    struct ass_shaper_metrics_data *metrics_priv = user_data;
+    struct ass_shaper_metrics_data *metrics_priv = font_data;
+    FT_Face face = metrics_priv->face;
     GlyphMetricsHashValue *metrics = get_cached_metrics(metrics_priv, face, 0, glyph);
 
     if (!metrics)
@@ -261,8 +295,8 @@ static hb_position_t
 cached_v_advance(hb_font_t *font, void *font_data, hb_codepoint_t glyph,
                  void *user_data)
 {
-    FT_Face face = font_data;
-    struct ass_shaper_metrics_data *metrics_priv = user_data;
+    struct ass_shaper_metrics_data *metrics_priv = font_data;
+    FT_Face face = metrics_priv->face;
     GlyphMetricsHashValue *metrics = get_cached_metrics(metrics_priv, face, 0, glyph);
 
     if (!metrics)
@@ -283,8 +317,8 @@ static hb_bool_t
 cached_v_origin(hb_font_t *font, void *font_data, hb_codepoint_t glyph,
                 hb_position_t *x, hb_position_t *y, void *user_data)
 {
-    FT_Face face = font_data;
-    struct ass_shaper_metrics_data *metrics_priv = user_data;
+    struct ass_shaper_metrics_data *metrics_priv = font_data;
+    FT_Face face = metrics_priv->face;
     GlyphMetricsHashValue *metrics = get_cached_metrics(metrics_priv, face, 0, glyph);
 
     if (!metrics)
@@ -300,13 +334,12 @@ static hb_position_t
 get_h_kerning(hb_font_t *font, void *font_data, hb_codepoint_t first,
                  hb_codepoint_t second, void *user_data)
 {
-    FT_Face face = font_data;
-    FT_Vector kern;
-
-    if (FT_Get_Kerning (face, first, second, FT_KERNING_DEFAULT, &kern))
-        return 0;
+    struct ass_shaper_metrics_data *metrics_priv = font_data;
+    GlyphMetricsHashKey *key = &metrics_priv->hash_key;
 
-    return kern.x;
+    return ass_font_get_kerning_pair(metrics_priv->kerning_cache, key->font,
+                                     key->face_index, key->size,
+                                     first, second).x;
 }
 
 static hb_position_t
@@ -320,8 +353,8 @@ static hb_bool_t
 cached_extents(hb_font_t *font, void *font_data, hb_codepoint_t glyph,
                hb_glyph_extents_t *extents, void *user_data)
 {
-    FT_Face face = font_data;
-    struct ass_shaper_metrics_data *metrics_priv = user_data;
+    struct ass_shaper_metrics_data *metrics_priv = font_data;
+    FT_Face face = metrics_priv->face;
     GlyphMetricsHashValue *metrics = get_cached_metrics(metrics_priv, face, 0, glyph);
 
     if (!metrics)
@@ -340,7 +373,8 @@ get_contour_point(hb_font_t *font, void *font_data, hb_codepoint_t glyph,
                      unsigned int point_index, hb_position_t *x,
                      hb_position_t *y, void *user_data)
 {
-    FT_Face face = font_data;
+    struct ass_shaper_metrics_data *metrics_priv = font_data;
+    FT_Face face = metrics_priv->face;
     int load_flags = FT_LOAD_DEFAULT | FT_LOAD_IGNORE_GLOBAL_ADVANCE_WIDTH
         | FT_LOAD_IGNORE_TRANSFORM;
 
@@ -356,6 +390,40 @@ get_contour_point(hb_font_t *font, void *font_data, hb_codepoint_t glyph,
     return 1;
 }
 
+/**
+ * \brief Get the cached glyph metrics functions, shared by all HarfBuzz
+ * fonts of the shaper. Each font passes its own metrics data as font data.
+ */
+static hb_font_funcs_t *get_font_funcs(ASS_Shaper *shaper)
+{
+    hb_font_funcs_t *funcs = shaper->font_funcs;
+
+    if (funcs)
+        return funcs;
+
+    funcs = shaper->font_funcs = hb_font_funcs_create();
+    hb_font_funcs_set_glyph_func(funcs, get_glyph, NULL, NULL);
+    hb_font_funcs_set_glyph_h_advance_func(funcs, cached_h_advance,
+            NULL, NULL);
+    hb_font_funcs_set_glyph_v_advance_func(funcs, cached_v_advance,
+            NULL, NULL);
+    hb_font_funcs_set_glyph_h_origin_func(funcs, cached_h_origin,
+            NULL, NULL);
+    hb_font_funcs_set_glyph_v_origin_func(funcs, cached_v_origin,
+            NULL, NULL);
+    hb_font_funcs_set_glyph_h_kerning_func(funcs, get_h_kerning,
+            NULL, NULL);
+    hb_font_funcs_set_glyph_v_kerning_func(funcs, get_v_kerning,
+            NULL, NULL);
+    hb_font_funcs_set_glyph_extents_func(funcs, cached_extents,
+            NULL, NULL);
+    hb_font_funcs_set_glyph_contour_point_func(funcs, get_contour_point,
+            NULL, NULL);
+    hb_font_funcs_make_immutable(funcs);
+
+    return funcs;
+}
+
 /**
  * \brief Retrieve HarfBuzz font from cache.
  * Create it from FreeType font, if needed.
@@ -366,6 +434,7 @@ static hb_font_t *get_hb_font(ASS_Shaper *shaper, GlyphInfo *info)
 {
     ASS_Font *font = info->font;
     hb_font_t **hb_fonts;
+    struct ass_shaper_metrics_data *metrics;
 
     if (!font->shaper_priv)
         font->shaper_priv = calloc(sizeof(ASS_ShaperFontData), 1);
@@ -379,41 +448,21 @@ static hb_font_t *get_hb_font(ASS_Shaper *shaper, GlyphInfo *info)
         // set up cached metrics access
         font->shaper_priv->metrics_data[info->face_index] =
             calloc(sizeof(struct ass_shaper_metrics_data), 1);
-        struct ass_shaper_metrics_data *metrics =
-            font->shaper_priv->metrics_data[info->face_index];
+        metrics = font->shaper_priv->metrics_data[info->face_index];
+        metrics->face = font->faces[info->face_index];
         metrics->metrics_cache = shaper->metrics_cache;
+        metrics->kerning_cache = shaper->kerning_cache;
         metrics->vertical = info->font->desc.vertical;
 
-        hb_font_funcs_t *funcs = hb_font_funcs_create();
-        font->shaper_priv->font_funcs[info->face_index] = funcs;
-        hb_font_funcs_set_glyph_func(funcs, get_glyph,
-                metrics, NULL);
-        hb_font_funcs_set_glyph_h_advance_func(funcs, cached_h_advance,
+        hb_font_set_funcs(hb_fonts[info->face_index], get_font_funcs(shaper),
                 metrics, NULL);
-        hb_font_funcs_set_glyph_v_advance_func(funcs, cached_v_advance,
-                metrics, NULL);
-        hb_font_funcs_set_glyph_h_origin_func(funcs, cached_h_origin,
-                metrics, NULL);
-        hb_font_funcs_set_glyph_v_origin_func(funcs, cached_v_origin,
-                metrics, NULL);
-        hb_font_funcs_set_glyph_h_kerning_func(funcs, get_h_kerning,
-                metrics, NULL);
-        hb_font_funcs_set_glyph_v_kerning_func(funcs, get_v_kerning,
-                metrics, NULL);
-        hb_font_funcs_set_glyph_extents_func(funcs, cached_extents,
-                metrics, NULL);
-        hb_font_funcs_set_glyph_contour_point_func(funcs, get_contour_point,
-                metrics, NULL);
-        hb_font_set_funcs(hb_fonts[info->face_index], funcs,
-                font->faces[info->face_index], NULL);
     }
 
+    metrics = font->shaper_priv->metrics_data[info->face_index];
     ass_face_set_size(font->faces[info->face_index], info->font_size);
-    update_hb_size(hb_fonts[info->face_index], font->faces[info->face_index]);
+    update_hb_size(hb_fonts[info->face_index], metrics);
 
     // update hash key for cached metrics
-    struct ass_shaper_metrics_data *metrics =
-        font->shaper_priv->metrics_data[info->face_index];
     metrics->hash_key.font = info->font;
     metrics->hash_key.face_index = info->face_index;
     metrics->hash_key.size = info->font_size;
@@ -577,7 +626,7 @@ shape_harfbuzz_process_run(GlyphInfo *glyphs, hb_buffer_t *buf, int offset)
 static void shape_harfbuzz(ASS_Shaper *shaper, GlyphInfo *glyphs, size_t len)
 {
     int i;
-    hb_buffer_t *buf = hb_buffer_create();
+    hb_buffer_t *buf = shaper->buf;
     hb_segment_properties_t props = HB_SEGMENT_PROPERTIES_DEFAULT;
 
     // Initialize: skip all glyphs, this is undone later as needed
@@ -607,10 +656,8 @@ static void shape_harfbuzz(ASS_Shaper *shaper, GlyphInfo *glyphs, size_t len)
         hb_shape(font, buf, shaper->features, shaper->n_features);
 
         shape_harfbuzz_process_run(glyphs, buf, offset);
-        hb_buffer_reset(buf);
+        hb_buffer_clear_contents(buf);
     }
-
-    hb_buffer_destroy(buf);
 }
 
 /**
@@ -672,7 +719,7 @@ void ass_shaper_determine_script(ASS_Shaper *shaper, GlyphInfo *glyphs,
 static void shape_fribidi(ASS_Shaper *shaper, GlyphInfo *glyphs, size_t len)
 {
     int i;
-    FriBidiJoiningType *joins = calloc(sizeof(*joins), len);
+    FriBidiJoiningType *joins = shaper->joins;
 
     // shape on codepoint level
     fribidi_get_joining_types(shaper->event_text, len, joins);
@@ -687,8 +734,6 @@ static void shape_fribidi(ASS_Shaper *shaper, GlyphInfo *glyphs, size_t len)
         info->symbol = shaper->event_text[i];
         info->glyph_index = FT_Get_Char_Index(face, ass_font_index_magic(face, shaper->event_text[i]));
     }
-
-    free(joins);
 }
 
 /**
@@ -879,16 +924,78 @@ ASS_Shaper *ass_shaper_new(size_t prealloc)
 
     shaper->base_direction = FRIBIDI_PAR_ON;
     check_allocations(shaper, prealloc);
+    shaper->kerning_cache = ass_kerning_cache_create();
 
 #ifdef CONFIG_HARFBUZZ
     init_features(shaper);
     shaper->metrics_cache = ass_glyph_metrics_cache_create();
+    shaper->buf = hb_buffer_create();
 #endif
 
     return shaper;
 }
 
 
+/**
+ * \brief Empty the glyph metrics and kerning caches if they hold at least
+ * max_size items each
+ * \param max_size limit, 0 to empty the caches unconditionally
+ * \return 1 if a cache was emptied, 0 otherwise
+ */
+int ass_shaper_empty_cache(ASS_Shaper *shaper, size_t max_size)
+{
+    int emptied = ass_cache_empty(shaper->kerning_cache, max_size);
+#ifdef CONFIG_HARFBUZZ
+    emptied |= ass_cache_empty(shaper->metrics_cache, max_size);
+#endif
+    return emptied;
+}
+
+static int kerning_font_evicted(void *key, void *value, void *priv)
+{
+    return ((KerningHashKey *) key)->font->evicted;
+}
+
+#ifdef CONFIG_HARFBUZZ
+static int metrics_font_evicted(void *key, void *value, void *priv)
+{
+    return ((GlyphMetricsHashKey *) key)->font->evicted;
+}
+#endif
+
+/**
+ * \brief Remove the glyph metrics and kerning pairs of the fonts that are
+ * being evicted from the font cache
+ */
+void ass_shaper_evict_fonts(ASS_Shaper *shaper)
+{
+    ass_cache_remove_if(shaper->kerning_cache, kerning_font_evicted, NULL);
+#ifdef CONFIG_HARFBUZZ
+    ass_cache_remove_if(shaper->metrics_cache, metrics_font_evicted, NULL);
+#endif
+}
+
+/**
+ * \brief Get glyph metrics or kerning cache counters
+ * \param type ASS_CACHE_GLYPH_METRICS or ASS_CACHE_KERNING
+ * \return 0 on success, -1 if there is no such cache
+ */
+int ass_shaper_cache_stats(ASS_Shaper *shaper, ASS_CacheType type,
+                           ASS_CacheStats *stats)
+{
+    if (type == ASS_CACHE_KERNING) {
+        ass_cache_stats(shaper->kerning_cache, stats);
+        return 0;
+    }
+#ifdef CONFIG_HARFBUZZ
+    if (type == ASS_CACHE_GLYPH_METRICS) {
+        ass_cache_stats(shaper->metrics_cache, stats);
+        return 0;
+    }
+#endif
+    return -1;
+}
+
 /**
  * \brief clean up additional data temporarily needed for shaping and
  * (e.g. additional glyphs allocated)
@@ -35,6 +35,10 @@ void ass_shaper_set_language(ASS_Shaper *shaper, const char *code);
 void ass_shaper_set_level(ASS_Shaper *shaper, ASS_ShapingLevel level);
 void ass_shaper_shape(ASS_Shaper *shaper, TextInfo *text_info);
 void ass_shaper_cleanup(ASS_Shaper *shaper, TextInfo *text_info);
+int ass_shaper_empty_cache(ASS_Shaper *shaper, size_t max_size);
+void ass_shaper_evict_fonts(ASS_Shaper *shaper);
+int ass_shaper_cache_stats(ASS_Shaper *shaper, ASS_CacheType type,
+                           ASS_CacheStats *stats);
 FriBidiStrIndex *ass_shaper_reorder(ASS_Shaper *shaper, TextInfo *text_info);
 FriBidiParType resolve_base_direction(int font_encoding);
 
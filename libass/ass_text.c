@@ -0,0 +1,130 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Pre-decoded event text.  The characters of an event are decoded from
+ * UTF-8 and its escapes resolved once, instead of on every frame the event
+ * is rendered.  Override blocks are kept as offsets into the text, since
+ * their tags depend on the time and have to be parsed every frame anyway.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ass_utils.h"
+#include "ass_text.h"
+
+/**
+ * \brief Decode event text, splitting it like ass_render_event and
+ * get_next_char do
+ * \return decoded text, NULL on failure
+ */
+DecodedText *ass_decode_text(char *text)
+{
+    size_t len = strlen(text);
+    DecodedText *decoded, *shrunk;
+    uint32_t *u;
+    char *p = text;
+
+    if (len >= TEXT_SOFT_BREAK)
+        return NULL;
+    // one unit per byte at most, plus an unterminated block and the end
+    decoded = malloc(sizeof(*decoded) + (len + 2) * sizeof(uint32_t));
+    if (!decoded)
+        return NULL;
+    decoded->text = text;
+    decoded->simple = 1;
+    u = decoded->units;
+
+    while (*p) {
+        if (*p == '{') {
+            char *end = strchr(p, '}');
+            end = end ? end + 1 : text + len;
+            *u++ = TEXT_TAGS | (p + 1 - text);
+            *u++ = end - text;
+            decoded->simple = 0;
+            p = end;
+        } else if (*p == '\t') {
+            *u++ = ' ';
+            ++p;
+        } else if (*p == '\\' && p[1] == 'N') {
+            *u++ = '\n';
+            p += 2;
+        } else if (*p == '\\' && p[1] == 'n') {
+            *u++ = TEXT_SOFT_BREAK;
+            p += 2;
+        } else if (*p == '\\' && p[1] == 'h') {
+            *u++ = NBSP;
+            p += 2;
+        } else if (*p == '\\' && (p[1] == '{' || p[1] == '}')) {
+            *u++ = p[1];
+            p += 2;
+        } else
+            *u++ = ass_utf8_get_char(&p);
+    }
+    *u++ = 0;
+
+    shrunk = realloc(decoded, sizeof(*decoded) +
+                     (u - decoded->units) * sizeof(uint32_t));
+    return shrunk ? shrunk : decoded;
+}
+
+/**
+ * \brief Get the decoded text of an event, decoding it if the event has
+ * none yet or its Text was replaced.  Text modified in place, or replaced
+ * by a string at the same address, is only noticed after
+ * ass_event_text_changed; checking the contents on every frame would cost
+ * about as much as decoding again.
+ * \return decoded text, NULL on failure
+ */
+DecodedText *ass_event_decoded_text(ASS_Event *event)
+{
+    RenderPriv *priv = event->render_priv;
+
+    if (!priv) {
+        priv = event->render_priv = calloc(1, sizeof(RenderPriv));
+        if (!priv)
+            return NULL;
+    }
+    if (priv->decoded && priv->decoded->text == event->Text)
+        return priv->decoded;
+
+    free(priv->decoded);
+    priv->decoded = event->Text ? ass_decode_text(event->Text) : NULL;
+    return priv->decoded;
+}
+
+/**
+ * \brief Drop the decoded text of an event, after its Text was set
+ */
+void ass_event_text_changed(ASS_Event *event)
+{
+    RenderPriv *priv = event->render_priv;
+
+    if (priv) {
+        free(priv->decoded);
+        priv->decoded = NULL;
+    }
+}
+
+void ass_free_render_priv(ASS_RenderPriv *priv)
+{
+    if (priv)
+        free(priv->decoded);
+    free(priv);
+}
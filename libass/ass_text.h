@@ -0,0 +1,52 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef LIBASS_TEXT_H
+#define LIBASS_TEXT_H
+
+#include <stdint.h>
+
+#include "ass_types.h"
+
+#define NBSP 0xa0   // unicode non-breaking space character
+
+/*
+ * Units of pre-decoded event text.  Anything else is a character, as
+ * returned by get_next_char; 0 ends the text.
+ */
+#define TEXT_TAGS       0x80000000  // | offset of an override block's
+                                    // first tag; the next unit is the
+                                    // offset just past its '}'
+#define TEXT_SOFT_BREAK 0x40000000  // \n, a space unless WrapStyle is 2
+
+typedef struct {
+    char *text;                 // event Text the units were decoded from
+    int simple;                 // no override blocks
+    uint32_t units[];
+} DecodedText;
+
+typedef struct render_priv {
+    int top, height, left, width;
+    int render_id;
+    DecodedText *decoded;       // NULL if not decoded
+} RenderPriv;
+
+DecodedText *ass_decode_text(char *text);
+DecodedText *ass_event_decoded_text(ASS_Event *event);
+void ass_event_text_changed(ASS_Event *event);
+void ass_free_render_priv(ASS_RenderPriv *priv);
+
+#endif                          /* LIBASS_TEXT_H */
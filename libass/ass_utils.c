@@ -89,6 +89,232 @@ void ass_aligned_free(void *ptr)
         free(*((void **)ptr - 1));
 }
 
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGN 16
+#define ARENA_HEADER ass_align(ARENA_ALIGN, sizeof(ArenaBlock))
+
+static ArenaBlock *arena_new_block(size_t size, ArenaBlock *next)
+{
+    ArenaBlock *block = malloc(ARENA_HEADER + size);
+    if (!block)
+        return NULL;
+    block->next = next;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+static void *arena_alloc(Arena *arena, size_t size)
+{
+    ArenaBlock *block = arena->block;
+
+    if (!block || block->size - block->used < size) {
+        size_t block_size = ARENA_BLOCK_SIZE;
+        if (block && block->size * 2 > block_size)
+            block_size = block->size * 2;
+        if (block_size < size)
+            block_size = size;
+        block = arena_new_block(block_size, block);
+        if (!block)
+            return NULL;
+        arena->block = block;
+    }
+
+    block->used += size;
+    return (char *) block + ARENA_HEADER + block->used - size;
+}
+
+void *ass_arena_alloc(Arena *arena, size_t size)
+{
+    return arena_alloc(arena, ass_align(ARENA_ALIGN, size));
+}
+
+void ass_arena_reset(Arena *arena)
+{
+    ArenaBlock *block = arena->block;
+    size_t total = 0;
+
+    if (!block)
+        return;
+    if (!block->next) {
+        block->used = 0;
+        return;
+    }
+
+    // replace the chain with one block that fits everything at once
+    while (block) {
+        ArenaBlock *next = block->next;
+        total += block->size;
+        free(block);
+        block = next;
+    }
+    arena->block = arena_new_block(total, NULL);
+}
+
+void ass_arena_free(Arena *arena)
+{
+    ArenaBlock *block = arena->block;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->block = NULL;
+}
+
+#define STRING_POOL_MIN_TABLE 256
+
+/**
+ * \brief Find the block that would hold ptr in the sorted block list
+ * \return index of the last block starting at or before ptr, or -1
+ */
+static ptrdiff_t pool_find_block(StringPool *pool, const void *ptr)
+{
+    ptrdiff_t lo = 0, hi = pool->n_blocks;
+
+    while (lo < hi) {
+        ptrdiff_t mid = lo + (hi - lo) / 2;
+        if ((uintptr_t) pool->blocks[mid] <= (uintptr_t) ptr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - 1;
+}
+
+static void pool_add_block(StringPool *pool, ArenaBlock *block)
+{
+    ptrdiff_t pos = pool_find_block(pool, block) + 1;
+
+    memmove(pool->blocks + pos + 1, pool->blocks + pos,
+            (pool->n_blocks - pos) * sizeof(ArenaBlock *));
+    pool->blocks[pos] = block;
+    pool->n_blocks++;
+}
+
+/**
+ * \brief Copy a string into the pool
+ */
+char *ass_pool_strdup(StringPool *pool, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    ArenaBlock *block = pool->arena.block;
+    char *copy;
+
+    // make room for a new block up front, so that every block the arena
+    // allocates is known to ass_pool_owns
+    if (pool->n_blocks == pool->max_blocks) {
+        size_t max = pool->max_blocks ? pool->max_blocks * 2 : 8;
+        ArenaBlock **blocks = realloc(pool->blocks, max * sizeof(ArenaBlock *));
+        if (!blocks)
+            return NULL;
+        pool->blocks = blocks;
+        pool->max_blocks = max;
+    }
+
+    // strings need no alignment, so pack them
+    copy = arena_alloc(&pool->arena, len);
+    if (!copy)
+        return NULL;
+    if (pool->arena.block != block)
+        pool_add_block(pool, pool->arena.block);
+    memcpy(copy, str, len);
+    return copy;
+}
+
+static int pool_grow_table(StringPool *pool)
+{
+    size_t size = pool->table_size ? pool->table_size * 2 :
+                  STRING_POOL_MIN_TABLE;
+    char **table = calloc(size, sizeof(char *));
+    size_t i;
+
+    if (!table)
+        return -1;
+    for (i = 0; i < pool->table_size; i++) {
+        char *str = pool->table[i];
+        size_t pos;
+        if (!str)
+            continue;
+        pos = ass_hash_final(ass_hash_str(str, ASS_HASH_INIT));
+        while (table[pos & (size - 1)])
+            pos++;
+        table[pos & (size - 1)] = str;
+    }
+    free(pool->table);
+    pool->table = table;
+    pool->table_size = size;
+    return 0;
+}
+
+/**
+ * \brief Get the pooled copy of a string, shared by all equal strings
+ * interned in the same pool.  Interned strings must not be modified.
+ */
+char *ass_pool_intern(StringPool *pool, const char *str)
+{
+    size_t pos;
+
+    // keep the load factor at 1/2 at most
+    if (pool->count * 2 >= pool->table_size && pool_grow_table(pool) < 0)
+        return NULL;
+
+    pos = ass_hash_final(ass_hash_str(str, ASS_HASH_INIT));
+    while (1) {
+        char **slot = pool->table + (pos & (pool->table_size - 1));
+        if (!*slot) {
+            *slot = ass_pool_strdup(pool, str);
+            if (*slot)
+                pool->count++;
+            return *slot;
+        }
+        if (strcmp(*slot, str) == 0)
+            return *slot;
+        pos++;
+    }
+}
+
+/**
+ * \brief Check whether a string belongs to the pool, in time logarithmic
+ * in the number of blocks
+ */
+int ass_pool_owns(StringPool *pool, const char *str)
+{
+    ptrdiff_t i = pool_find_block(pool, str);
+    const char *start;
+
+    if (i < 0)
+        return 0;
+    start = (const char *) pool->blocks[i] + ARENA_HEADER;
+    return str >= start && str < start + pool->blocks[i]->used;
+}
+
+/**
+ * \brief Drop all strings, keeping the memory for reuse
+ */
+void ass_pool_reset(StringPool *pool)
+{
+    ass_arena_reset(&pool->arena);
+    // the reset leaves at most one block
+    pool->n_blocks = 0;
+    if (pool->arena.block)
+        pool_add_block(pool, pool->arena.block);
+    if (pool->table)
+        memset(pool->table, 0, pool->table_size * sizeof(char *));
+    pool->count = 0;
+}
+
+void ass_pool_free(StringPool *pool)
+{
+    ass_arena_free(&pool->arena);
+    free(pool->blocks);
+    pool->blocks = NULL;
+    pool->n_blocks = pool->max_blocks = 0;
+    free(pool->table);
+    pool->table = NULL;
+    pool->table_size = pool->count = 0;
+}
+
 int mystrtoi(char **p, int *res)
 {
     double temp_res;
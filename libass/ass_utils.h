@@ -52,6 +52,40 @@ int has_avx2(void);
 void *ass_aligned_alloc(size_t alignment, size_t size);
 void ass_aligned_free(void *ptr);
 
+// Bump allocator for short-lived data, released all at once with
+// ass_arena_reset.  Blocks are merged on reset so that a steady workload
+// ends up with a single block and no malloc calls at all.
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size;                // usable size
+    size_t used;
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *block;          // current block, older blocks follow it
+} Arena;
+
+void *ass_arena_alloc(Arena *arena, size_t size);
+void ass_arena_reset(Arena *arena);
+void ass_arena_free(Arena *arena);
+
+// Strings allocated from an arena, optionally interned
+typedef struct {
+    Arena arena;
+    ArenaBlock **blocks;        // blocks of the arena sorted by address
+    size_t n_blocks;
+    size_t max_blocks;
+    char **table;               // interned strings, open addressing
+    size_t table_size;          // power of two, 0 until first use
+    size_t count;
+} StringPool;
+
+char *ass_pool_strdup(StringPool *pool, const char *str);
+char *ass_pool_intern(StringPool *pool, const char *str);
+int ass_pool_owns(StringPool *pool, const char *str);
+void ass_pool_reset(StringPool *pool);
+void ass_pool_free(StringPool *pool);
+
 int mystrtoi(char **p, int *res);
 int mystrtoll(char **p, long long *res);
 int mystrtou32(char **p, int base, uint32_t *res);
@@ -134,31 +168,54 @@ static inline int rot_key(double a)
     return double_to_d22(a) % m;
 }
 
-#define FNV1_32A_INIT 0x811c9dc5U
-#define FNV1_32A_PRIME 16777619U
+/*
+ * 64-bit hash for cache keys.  Input is consumed 8 bytes at a time, each
+ * word mixed in with a multiply and rotate; ass_hash_final avalanches the
+ * state so that the low bits can be used as a bucket index directly.
+ */
+#define ASS_HASH_INIT 0x2545f4914f6cdd1dULL
+#define ASS_HASH_K1 0x87c37b91114253d5ULL
+#define ASS_HASH_K2 0x4cf5ad432745937fULL
 
-static inline unsigned fnv_32a_buf(void *buf, size_t len, unsigned hval)
+static inline uint64_t ass_hash_mix(uint64_t hval, uint64_t v)
 {
-    unsigned char *bp = buf;
-    size_t n = (len + 3) / 4;
+    v *= ASS_HASH_K1;
+    v = (v << 31) | (v >> 33);
+    hval ^= v * ASS_HASH_K2;
+    return ((hval << 27) | (hval >> 37)) * 5 + 0x52dce729;
+}
 
-    switch (len % 4) {
-    case 0: do { hval ^= (unsigned) *bp++; hval *= FNV1_32A_PRIME;
-    case 3:      hval ^= (unsigned) *bp++; hval *= FNV1_32A_PRIME;
-    case 2:      hval ^= (unsigned) *bp++; hval *= FNV1_32A_PRIME;
-    case 1:      hval ^= (unsigned) *bp++; hval *= FNV1_32A_PRIME;
-               } while (--n > 0);
-    }
+static inline uint64_t ass_hash_buf(const void *buf, size_t len,
+                                    uint64_t hval)
+{
+    const unsigned char *p = buf;
+    uint64_t v;
 
+    for (; len >= 8; len -= 8, p += 8) {
+        memcpy(&v, p, 8);
+        hval = ass_hash_mix(hval, v);
+    }
+    if (len) {
+        v = 0;
+        memcpy(&v, p, len);
+        hval = ass_hash_mix(hval, v ^ ((uint64_t) len << 59));
+    }
     return hval;
 }
-static inline unsigned fnv_32a_str(char *str, unsigned hval)
+
+static inline uint64_t ass_hash_str(const char *str, uint64_t hval)
 {
-    unsigned char *s = (unsigned char *) str;
-    while (*s) {
-        hval ^= (unsigned) *s++;
-        hval *= FNV1_32A_PRIME;
-    }
+    size_t len = strlen(str);
+    return ass_hash_buf(str, len, ass_hash_mix(hval, len));
+}
+
+static inline uint64_t ass_hash_final(uint64_t hval)
+{
+    hval ^= hval >> 33;
+    hval *= 0xff51afd7ed558ccdULL;
+    hval ^= hval >> 33;
+    hval *= 0xc4ceb9fe1a85ec53ULL;
+    hval ^= hval >> 33;
     return hval;
 }
 
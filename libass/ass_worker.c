@@ -0,0 +1,208 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Minimal fixed-size worker pool.  ass_worker_pool_run hands out a batch
+ * of independent jobs to the pool threads and the calling thread, and
+ * returns once all of them are finished.  Without pthreads, or if the
+ * pool could not be created, the jobs simply run in the calling thread.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef CONFIG_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "ass_worker.h"
+
+#ifdef CONFIG_PTHREAD
+struct ass_worker_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   // signalled when a batch is posted
+    pthread_cond_t done_cond;   // signalled when a batch is finished
+    pthread_t threads[WORKER_MAX_THREADS];
+    int n_threads;              // pool threads, not counting the caller
+    int quit;
+
+    // current batch
+    WorkerFunc func;
+    char *jobs;
+    size_t job_size;
+    int n_jobs;
+    int next_job;               // next job to hand out
+    int jobs_done;
+    unsigned batch;             // batch counter, wakes up idle threads
+};
+
+/**
+ * \brief Run jobs of the current batch until none are left.
+ * Must be called with the lock held; returns with the lock held.
+ */
+static void run_jobs(ASS_WorkerPool *pool)
+{
+    while (pool->next_job < pool->n_jobs) {
+        void *job = pool->jobs + pool->next_job++ * pool->job_size;
+        pthread_mutex_unlock(&pool->lock);
+        pool->func(job);
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->jobs_done == pool->n_jobs)
+            pthread_cond_signal(&pool->done_cond);
+    }
+}
+
+static void *worker_thread(void *arg)
+{
+    ASS_WorkerPool *pool = arg;
+    unsigned batch = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->quit && pool->batch == batch)
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        if (pool->quit)
+            break;
+        batch = pool->batch;
+        run_jobs(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+#else
+struct ass_worker_pool {
+    int n_threads;
+};
+#endif
+
+/**
+ * \brief Number of online processors, at least 1
+ */
+int ass_cpu_count(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+        return n;
+#endif
+    return 1;
+}
+
+/**
+ * \brief Create a worker pool
+ * \param n_threads total number of threads working on a batch, including
+ * the thread calling ass_worker_pool_run
+ * \return new pool, or NULL if n_threads < 2 or threads are unavailable
+ */
+ASS_WorkerPool *ass_worker_pool_new(int n_threads)
+{
+#ifdef CONFIG_PTHREAD
+    ASS_WorkerPool *pool;
+    int i;
+
+    if (n_threads > WORKER_MAX_THREADS + 1)
+        n_threads = WORKER_MAX_THREADS + 1;
+    if (n_threads < 2)
+        return NULL;
+
+    pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (i = 0; i < n_threads - 1; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_thread, pool))
+            break;
+        pool->n_threads++;
+    }
+    if (!pool->n_threads) {
+        ass_worker_pool_free(pool);
+        return NULL;
+    }
+    return pool;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * \brief Total number of threads working on a batch
+ */
+int ass_worker_pool_threads(ASS_WorkerPool *pool)
+{
+    return pool ? pool->n_threads + 1 : 1;
+}
+
+/**
+ * \brief Run a batch of jobs and wait for all of them to finish
+ * \param pool worker pool, may be NULL
+ * \param func function called once for every job
+ * \param jobs array of n_jobs elements of job_size bytes each
+ */
+void ass_worker_pool_run(ASS_WorkerPool *pool, WorkerFunc func,
+                         void *jobs, size_t job_size, int n_jobs)
+{
+    int i;
+
+#ifdef CONFIG_PTHREAD
+    if (pool && n_jobs > 1) {
+        pthread_mutex_lock(&pool->lock);
+        pool->func = func;
+        pool->jobs = jobs;
+        pool->job_size = job_size;
+        pool->n_jobs = n_jobs;
+        pool->next_job = 0;
+        pool->jobs_done = 0;
+        pool->batch++;
+        pthread_cond_broadcast(&pool->work_cond);
+
+        run_jobs(pool);
+        while (pool->jobs_done < pool->n_jobs)
+            pthread_cond_wait(&pool->done_cond, &pool->lock);
+        pool->n_jobs = 0;
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+#endif
+
+    for (i = 0; i < n_jobs; i++)
+        func((char *) jobs + i * job_size);
+}
+
+void ass_worker_pool_free(ASS_WorkerPool *pool)
+{
+#ifdef CONFIG_PTHREAD
+    int i;
+
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->n_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+#endif
+}
@@ -0,0 +1,34 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef LIBASS_WORKER_H
+#define LIBASS_WORKER_H
+
+#include <stddef.h>
+
+#define WORKER_MAX_THREADS 16
+
+typedef struct ass_worker_pool ASS_WorkerPool;
+typedef void (*WorkerFunc)(void *job);
+
+ASS_WorkerPool *ass_worker_pool_new(int n_threads);
+int ass_worker_pool_threads(ASS_WorkerPool *pool);
+void ass_worker_pool_run(ASS_WorkerPool *pool, WorkerFunc func,
+                         void *jobs, size_t job_size, int n_jobs);
+void ass_worker_pool_free(ASS_WorkerPool *pool);
+int ass_cpu_count(void);
+
+#endif                          /* LIBASS_WORKER_H */
@@ -0,0 +1,126 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Gaussian blur benchmark: blurs a 3840x2160 mask, as produced by a
+ * full-screen drawing or a scaled-up sign, with several radii.  Prints the
+ * time of the single-threaded blur and of the banded blur on a worker
+ * pool, and fails if their outputs differ.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ass_render.h"
+#include "ass_parse.h"
+
+#define MASK_W 3840
+#define MASK_H 2160
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// filled ellipses of varying coverage, roughly like a big sign
+static void fill_mask(Bitmap *bm)
+{
+    int x, y, i;
+    srand(1);
+    for (i = 0; i < 200; i++) {
+        int cx = rand() % bm->w, cy = rand() % bm->h;
+        int rx = 20 + rand() % 300, ry = 20 + rand() % 200;
+        int v = 64 + rand() % 192;
+        for (y = FFMAX(cy - ry, 0); y < FFMIN(cy + ry, bm->h); y++)
+            for (x = FFMAX(cx - rx, 0); x < FFMIN(cx + rx, bm->w); x++) {
+                double dx = (double) (x - cx) / rx;
+                double dy = (double) (y - cy) / ry;
+                if (dx * dx + dy * dy <= 1)
+                    bm->buffer[y * bm->stride + x] = v;
+            }
+    }
+}
+
+static double run(ASS_SynthPriv *priv, ASS_WorkerPool *pool,
+                  const Bitmap *src, Bitmap *dst, int rounds)
+{
+    double t = 0;
+    int i;
+    for (i = 0; i < rounds; i++) {
+        double start;
+        memcpy(dst->buffer, src->buffer, src->stride * src->h);
+        start = now();
+        ass_gauss_blur_bitmap(priv, pool, dst);
+        t += now() - start;
+    }
+    return t / rounds;
+}
+
+int main(int argc, char *argv[])
+{
+    static const double radii[] = { 2, 8, 20, 60 };
+    int rounds = 3, threads = ass_cpu_count(), failed = 0;
+    ASS_SynthPriv *priv = ass_synth_init(BLUR_MAX_RADIUS);
+    ASS_WorkerPool *pool;
+    Bitmap *src, *ref, *out;
+    int i;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+    if (argc > 2)
+        threads = atoi(argv[2]);
+    if (rounds <= 0 || threads <= 0) {
+        printf("usage: %s [rounds] [threads]\n", argv[0]);
+        exit(1);
+    }
+
+    pool = ass_worker_pool_new(threads);
+    src = alloc_bitmap(MASK_W, MASK_H);
+    ref = alloc_bitmap(MASK_W, MASK_H);
+    out = alloc_bitmap(MASK_W, MASK_H);
+    fill_mask(src);
+
+    printf("%dx%d mask, %d threads\n", MASK_W, MASK_H,
+           ass_worker_pool_threads(pool));
+    printf("%8s %12s %12s %8s\n", "radius", "single ms", "tiled ms",
+           "speedup");
+    for (i = 0; i < sizeof(radii) / sizeof(radii[0]); i++) {
+        double t1, tn;
+        generate_tables(priv, radii[i]);
+        t1 = run(priv, NULL, src, ref, rounds);
+        tn = run(priv, pool, src, out, rounds);
+        printf("%8.0f %12.2f %12.2f %7.2fx", radii[i], t1, tn, t1 / tn);
+        if (memcmp(ref->buffer, out->buffer, ref->stride * ref->h)) {
+            printf("  MISMATCH");
+            failed = 1;
+        }
+        printf("\n");
+    }
+
+    ass_free_bitmap(src);
+    ass_free_bitmap(ref);
+    ass_free_bitmap(out);
+    ass_worker_pool_free(pool);
+    ass_synth_done(priv);
+
+    return failed;
+}
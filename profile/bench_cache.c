@@ -0,0 +1,323 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Cache lookup benchmark: fills each cache type with keys shaped like the
+ * renderer's and times lookups that hit and lookups that miss, through
+ * the typed accessors (ass_*_cache_get) and through the generic
+ * ass_cache_get, which calls the key functions by pointer.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ass_render.h"
+
+#define N_KEYS 20000
+
+typedef union {
+    ASS_FontDesc font;
+    OutlineHashKey outline;
+    GlyphMetricsHashKey metrics;
+    BitmapHashKey bitmap;
+    CompositeHashKey composite;
+    KerningHashKey kerning;
+} AnyKey;
+
+typedef struct {
+    const char *name;
+    Cache *(*create)(void);
+    size_t key_size;
+    void (*make_key)(void *key, int i);
+    void (*put)(Cache *cache, void *key, int i);
+    void *(*get)(Cache *cache, void *key);
+} CacheType;
+
+// glyph keys reference their font, and the caches count the references
+static ASS_Font fonts[5];
+
+static char *text_for(int i)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "m 0 0 l %d 0 %d %d 0 %d", i, i, i, i);
+    return strdup(buf);
+}
+
+// font cache: the value owns the family name shared with its key
+static void font_key(void *key, int i)
+{
+    ASS_FontDesc *k = key;
+    char buf[32];
+    memset(k, 0, sizeof(*k));
+    snprintf(buf, sizeof(buf), "Font Family %d", i);
+    k->family = strdup(buf);
+    k->bold = 400 + 300 * (i & 1);
+    k->italic = (i >> 1) & 1 ? 100 : 0;
+}
+
+static void font_put(Cache *cache, void *key, int i)
+{
+    ASS_Font font;
+    memset(&font, 0, sizeof(font));
+    font.desc = *(ASS_FontDesc *) key;
+    ass_font_cache_put(cache, &font.desc, &font);
+}
+
+static void *font_get(Cache *cache, void *key)
+{
+    return ass_font_cache_get(cache, key);
+}
+
+static void outline_key(void *key, int i)
+{
+    OutlineHashKey *k = key;
+    memset(k, 0, sizeof(*k));
+    if (i % 8 == 7) {
+        k->type = OUTLINE_DRAWING;
+        k->u.drawing.scale_x = k->u.drawing.scale_y = 1 << 16;
+        k->u.drawing.scale = 1;
+        k->u.drawing.text = text_for(i);
+        k->u.drawing.hash = ass_hash_str(k->u.drawing.text, ASS_HASH_INIT);
+    } else {
+        k->type = OUTLINE_GLYPH;
+        k->u.glyph.font = &fonts[i % 5];
+        k->u.glyph.size = 36 + 4 * (i % 3);
+        k->u.glyph.glyph_index = i;
+        k->u.glyph.scale_x = k->u.glyph.scale_y = 1 << 16;
+        k->u.glyph.outline.x = k->u.glyph.outline.y = 2 << 16;
+    }
+}
+
+static void outline_put(Cache *cache, void *key, int i)
+{
+    OutlineHashValue v;
+    memset(&v, 0, sizeof(v));
+    ass_outline_cache_put(cache, key, &v);
+}
+
+static void *outline_get(Cache *cache, void *key)
+{
+    return ass_outline_cache_get(cache, key);
+}
+
+static void metrics_key(void *key, int i)
+{
+    GlyphMetricsHashKey *k = key;
+    memset(k, 0, sizeof(*k));
+    k->font = &fonts[i % 5];
+    k->size = 36 + 4 * (i % 3);
+    k->glyph_index = i;
+    k->scale_x = k->scale_y = 1 << 16;
+}
+
+static void metrics_put(Cache *cache, void *key, int i)
+{
+    GlyphMetricsHashValue v;
+    memset(&v, 0, sizeof(v));
+    ass_glyph_metrics_cache_put(cache, key, &v);
+}
+
+static void *metrics_get(Cache *cache, void *key)
+{
+    return ass_glyph_metrics_cache_get(cache, key);
+}
+
+static void bitmap_key(void *key, int i)
+{
+    BitmapHashKey *k = key;
+    memset(k, 0, sizeof(*k));
+    if (i % 16 == 15) {
+        k->type = BITMAP_CLIP;
+        k->u.clip.text = text_for(i);
+    } else {
+        k->type = BITMAP_OUTLINE;
+        k->u.outline.outline = (OutlineHashValue *) (size_t) (0x1000 + 64 * i);
+        k->u.outline.blur = (i % 4) * 0.5;
+        k->u.outline.frz = (i % 7) << 16;
+        k->u.outline.advance.x = i % 64;
+    }
+}
+
+static void bitmap_put(Cache *cache, void *key, int i)
+{
+    BitmapHashValue v;
+    memset(&v, 0, sizeof(v));
+    ass_bitmap_cache_put(cache, key, &v);
+}
+
+static void *bitmap_get(Cache *cache, void *key)
+{
+    return ass_bitmap_cache_get(cache, key);
+}
+
+static void composite_key(void *key, int i)
+{
+    CompositeHashKey *k = key;
+    char buf[64];
+    memset(k, 0, sizeof(*k));
+    k->w = 200 + i % 300;
+    k->h = 48;
+    k->chars = 10 + i % 30;
+    k->border_x = k->border_y = 2;
+    k->scale_x = k->scale_y = 1;
+    k->advance.x = i % 64;
+    snprintf(buf, sizeof(buf), "Line of dialogue number %d", i);
+    k->str = strdup(buf);
+}
+
+static void composite_put(Cache *cache, void *key, int i)
+{
+    CompositeHashValue v;
+    memset(&v, 0, sizeof(v));
+    ass_composite_cache_put(cache, key, &v);
+}
+
+static void *composite_get(Cache *cache, void *key)
+{
+    return ass_composite_cache_get(cache, key);
+}
+
+static void kerning_key(void *key, int i)
+{
+    KerningHashKey *k = key;
+    memset(k, 0, sizeof(*k));
+    k->font = &fonts[i % 5];
+    k->size = 36 + 4 * (i % 3);
+    k->first = i / 64;
+    k->second = i % 64;
+}
+
+static void kerning_put(Cache *cache, void *key, int i)
+{
+    KerningHashValue v;
+    memset(&v, 0, sizeof(v));
+    ass_kerning_cache_put(cache, key, &v);
+}
+
+static void *kerning_get(Cache *cache, void *key)
+{
+    return ass_kerning_cache_get(cache, key);
+}
+
+static const CacheType types[] = {
+    { "font", ass_font_cache_create, sizeof(ASS_FontDesc),
+      font_key, font_put, font_get },
+    { "outline", ass_outline_cache_create, sizeof(OutlineHashKey),
+      outline_key, outline_put, outline_get },
+    { "metrics", ass_glyph_metrics_cache_create, sizeof(GlyphMetricsHashKey),
+      metrics_key, metrics_put, metrics_get },
+    { "bitmap", ass_bitmap_cache_create, sizeof(BitmapHashKey),
+      bitmap_key, bitmap_put, bitmap_get },
+    { "composite", ass_composite_cache_create, sizeof(CompositeHashKey),
+      composite_key, composite_put, composite_get },
+    { "kerning", ass_kerning_cache_create, sizeof(KerningHashKey),
+      kerning_key, kerning_put, kerning_get },
+};
+
+// free the strings of a lookup key, like the cache destructors do
+static void free_key(const CacheType *type, void *key)
+{
+    if (type->create == ass_font_cache_create)
+        free(((ASS_FontDesc *) key)->family);
+    else if (type->create == ass_composite_cache_create)
+        free(((CompositeHashKey *) key)->str);
+    else if (type->create == ass_outline_cache_create &&
+             ((OutlineHashKey *) key)->type == OUTLINE_DRAWING)
+        free(((OutlineHashKey *) key)->u.drawing.text);
+    else if (type->create == ass_bitmap_cache_create &&
+             ((BitmapHashKey *) key)->type == BITMAP_CLIP)
+        free(((BitmapHashKey *) key)->u.clip.text);
+}
+
+static double ns_per_lookup(clock_t start, int rounds)
+{
+    return (double) (clock() - start) * 1e9 / CLOCKS_PER_SEC /
+           ((double) rounds * N_KEYS);
+}
+
+static int bench(const CacheType *type, int rounds)
+{
+    Cache *cache = type->create();
+    char *hit = malloc(N_KEYS * type->key_size);
+    char *miss = malloc(N_KEYS * type->key_size);
+    double t_typed, t_generic, t_miss;
+    clock_t start;
+    int i, r, found = 0, failed = 0;
+
+    for (i = 0; i < N_KEYS; ++i) {
+        AnyKey key;
+        // the cache takes over the strings of inserted keys
+        type->make_key(&key, i);
+        type->put(cache, &key, i);
+        type->make_key(hit + i * type->key_size, i);
+        type->make_key(miss + i * type->key_size, i + N_KEYS);
+    }
+
+    start = clock();
+    for (r = 0; r < rounds; ++r)
+        for (i = 0; i < N_KEYS; ++i)
+            found += type->get(cache, hit + i * type->key_size) != NULL;
+    t_typed = ns_per_lookup(start, rounds);
+
+    start = clock();
+    for (r = 0; r < rounds; ++r)
+        for (i = 0; i < N_KEYS; ++i)
+            found += ass_cache_get(cache, hit + i * type->key_size) != NULL;
+    t_generic = ns_per_lookup(start, rounds);
+
+    start = clock();
+    for (r = 0; r < rounds; ++r)
+        for (i = 0; i < N_KEYS; ++i)
+            failed |= type->get(cache, miss + i * type->key_size) != NULL;
+    t_miss = ns_per_lookup(start, rounds);
+
+    failed |= found != 2 * rounds * N_KEYS;
+    printf("%-10s %10.1f %10.1f %10.1f%s\n", type->name, t_typed,
+           t_generic, t_miss, failed ? "  WRONG RESULT" : "");
+
+    for (i = 0; i < N_KEYS; ++i) {
+        free_key(type, hit + i * type->key_size);
+        free_key(type, miss + i * type->key_size);
+    }
+    free(hit);
+    free(miss);
+    ass_cache_done(cache);
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 50, failed = 0;
+    int i;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+    if (rounds <= 0) {
+        printf("usage: %s [rounds]\n", argv[0]);
+        exit(1);
+    }
+
+    printf("%d keys per cache, ns per lookup\n", N_KEYS);
+    printf("%-10s %10s %10s %10s\n", "", "hit", "hit (ptr)", "miss");
+    for (i = 0; i < sizeof(types) / sizeof(types[0]); ++i)
+        failed |= bench(&types[i], rounds);
+
+    return failed;
+}
@@ -0,0 +1,266 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Cache hashing benchmark: builds glyph metrics keys the way the shaper
+ * does (a few fonts and sizes, consecutive glyph indices) and compares
+ * the cache's 64-bit hash with the previous 32-bit FNV-1a hash: time per
+ * key, distinct hash values, and bucket chain lengths.  It then renders
+ * a short script and prints the chain length histogram of the renderer's
+ * outline and bitmap caches.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "ass_render.h"
+#include "ass_utils.h"
+
+#define N_FONTS 8
+#define N_SIZES 6
+#define N_GLYPHS 4000
+#define N_KEYS (N_FONTS * N_SIZES * N_GLYPHS)
+#define OLD_BUCKETS 0xFFFF
+#define NEW_BUCKETS 0x10000
+#define HIST_SIZE 8
+
+static unsigned fnv_32a_buf(void *buf, size_t len, unsigned hval)
+{
+    unsigned char *bp = buf;
+    while (len--) {
+        hval ^= (unsigned) *bp++;
+        hval *= 16777619U;
+    }
+    return hval;
+}
+
+static void make_keys(GlyphMetricsHashKey *keys)
+{
+    void *fonts[N_FONTS];
+    int f, s, g, n = 0;
+
+    // real fonts are heap allocated, so use heap addresses
+    for (f = 0; f < N_FONTS; ++f)
+        fonts[f] = malloc(sizeof(ASS_Font));
+
+    for (f = 0; f < N_FONTS; ++f)
+        for (s = 0; s < N_SIZES; ++s)
+            for (g = 0; g < N_GLYPHS; ++g) {
+                GlyphMetricsHashKey *k = keys + n++;
+                memset(k, 0, sizeof(*k));
+                k->font = fonts[f];
+                k->size = 20 + 4 * s;
+                k->face_index = 0;
+                k->glyph_index = g;
+                k->scale_x = k->scale_y = 1 << 16;
+            }
+
+    for (f = 0; f < N_FONTS; ++f)
+        free(fonts[f]);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_histogram(const char *name, unsigned *hist)
+{
+    int i;
+    printf("%-12s", name);
+    for (i = 0; i < HIST_SIZE; ++i)
+        printf(" %7u", hist[i]);
+    printf("\n");
+}
+
+static void histogram(unsigned *buckets, unsigned n_buckets, unsigned *hist)
+{
+    unsigned i;
+    memset(hist, 0, HIST_SIZE * sizeof(*hist));
+    for (i = 0; i < n_buckets; ++i)
+        hist[FFMIN(buckets[i], HIST_SIZE - 1)]++;
+}
+
+static int distinct(uint64_t *hashes, int n)
+{
+    int i, count = n > 0;
+    qsort(hashes, n, sizeof(*hashes), cmp_u64);
+    for (i = 1; i < n; ++i)
+        count += hashes[i] != hashes[i - 1];
+    return count;
+}
+
+static void bench_keys(int rounds)
+{
+    GlyphMetricsHashKey *keys = malloc(N_KEYS * sizeof(*keys));
+    uint64_t *hashes = malloc(N_KEYS * sizeof(*hashes));
+    unsigned *buckets = calloc(NEW_BUCKETS, sizeof(*buckets));
+    unsigned hist[HIST_SIZE];
+    unsigned sink = 0;
+    clock_t start;
+    double t_old, t_new;
+    int i, r;
+
+    make_keys(keys);
+
+    start = clock();
+    for (r = 0; r < rounds; ++r)
+        for (i = 0; i < N_KEYS; ++i)
+            sink += fnv_32a_buf(keys + i, sizeof(*keys), 0x811c9dc5U);
+    t_old = (double) (clock() - start) * 1e9 / CLOCKS_PER_SEC /
+            ((double) rounds * N_KEYS);
+
+    start = clock();
+    for (r = 0; r < rounds; ++r)
+        for (i = 0; i < N_KEYS; ++i)
+            sink += ass_hash_final(ass_hash_buf(keys + i, sizeof(*keys),
+                                                ASS_HASH_INIT));
+    t_new = (double) (clock() - start) * 1e9 / CLOCKS_PER_SEC /
+            ((double) rounds * N_KEYS);
+
+    printf("%d glyph metrics keys (%d bytes each)\n", N_KEYS,
+           (int) sizeof(*keys));
+    printf("%-12s %7s %8s\n", "", "ns/key", "distinct");
+    printf("%-12s %7.2f", "fnv32", t_old);
+    for (i = 0; i < N_KEYS; ++i) {
+        unsigned h = fnv_32a_buf(keys + i, sizeof(*keys), 0x811c9dc5U);
+        hashes[i] = h;
+        buckets[h % OLD_BUCKETS]++;
+    }
+    printf(" %8d\n", distinct(hashes, N_KEYS));
+    histogram(buckets, OLD_BUCKETS, hist);
+
+    memset(buckets, 0, NEW_BUCKETS * sizeof(*buckets));
+    printf("%-12s %7.2f", "hash64", t_new);
+    for (i = 0; i < N_KEYS; ++i) {
+        hashes[i] = ass_hash_final(ass_hash_buf(keys + i, sizeof(*keys),
+                                                ASS_HASH_INIT));
+        buckets[hashes[i] & (NEW_BUCKETS - 1)]++;
+    }
+    printf(" %8d\n", distinct(hashes, N_KEYS));
+
+    printf("\nbuckets by chain length (last column: %d or more)\n",
+           HIST_SIZE - 1);
+    printf("%-12s", "");
+    for (i = 0; i < HIST_SIZE; ++i)
+        printf(" %7d", i);
+    printf("\n");
+    print_histogram("fnv32", hist);
+    histogram(buckets, NEW_BUCKETS, hist);
+    print_histogram("hash64", hist);
+
+    if (sink == 1)
+        printf("\n");
+
+    free(keys);
+    free(hashes);
+    free(buckets);
+}
+
+static const char script[] =
+    "[Script Info]\n"
+    "ScriptType: v4.00+\n"
+    "PlayResX: 1280\n"
+    "PlayResY: 720\n"
+    "\n"
+    "[V4+ Styles]\n"
+    "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, "
+    "OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, "
+    "ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, "
+    "Alignment, MarginL, MarginR, MarginV, Encoding\n"
+    "Style: Default,Sans,48,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,"
+    "0,0,0,0,100,100,0,0,1,2,1,2,40,40,30,1\n"
+    "\n"
+    "[Events]\n"
+    "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, "
+    "Effect, Text\n";
+
+void msg_callback(int level, const char *fmt, va_list va, void *data)
+{
+    if (level > 1)
+        return;
+    printf("libass: ");
+    vprintf(fmt, va);
+    printf("\n");
+}
+
+static void bench_render(void)
+{
+    static const char *text[] = {
+        "The quick brown fox jumps over the lazy dog.",
+        "{\\fs36\\bord3}Pack my box with five dozen liquor jugs!",
+        "{\\i1\\fs60}Sphinx of black quartz, judge my vow.",
+        "{\\b1\\blur2}How vexingly quick daft zebras jump.",
+    };
+    ASS_Library *library = ass_library_init();
+    ASS_Renderer *renderer = ass_renderer_init(library);
+    ASS_Track *track = ass_new_track(library);
+    unsigned hist[HIST_SIZE];
+    char buf[256];
+    int i;
+
+    ass_set_message_cb(library, msg_callback, NULL);
+    ass_set_frame_size(renderer, 1280, 720);
+    ass_set_fonts(renderer, NULL, "Sans", 1, NULL, 1);
+    ass_process_codec_private(track, (char *) script, strlen(script));
+
+    for (i = 0; i < 400; ++i) {
+        int len = snprintf(buf, sizeof(buf),
+                "%d,0,Default,,0,0,0,,{\\fscx%d}%s", i, 80 + i % 40,
+                text[i % 4]);
+        ass_process_chunk(track, buf, len, i * 10, 10);
+    }
+    for (i = 0; i < 400; ++i)
+        ass_render_frame(renderer, track, i * 10 + 5, NULL);
+
+    printf("\nrenderer caches after %d frames\n", 400);
+    ass_cache_chain_histogram(renderer->cache.outline_cache, hist,
+                              HIST_SIZE);
+    print_histogram("outline", hist);
+    ass_cache_chain_histogram(renderer->cache.bitmap_cache, hist,
+                              HIST_SIZE);
+    print_histogram("bitmap", hist);
+    ass_cache_chain_histogram(renderer->cache.composite_cache, hist,
+                              HIST_SIZE);
+    print_histogram("composite", hist);
+
+    ass_free_track(track);
+    ass_renderer_done(renderer);
+    ass_library_done(library);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 20;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+    if (rounds <= 0) {
+        printf("usage: %s [rounds]\n", argv[0]);
+        exit(1);
+    }
+
+    bench_keys(rounds);
+    bench_render();
+
+    return 0;
+}
@@ -0,0 +1,283 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Layout benchmark: renders frames of long, wrapped events with warm
+ * caches, so the time goes into laying out the glyphs rather than into
+ * rasterizing them.  Prints the time and, where the kernel exposes
+ * hardware counters (perf_event_open on Linux), the cache misses per
+ * frame and per glyph.  Also prints how many cache lines of a GlyphInfo
+ * the fields read by the layout passes span.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "ass_render.h"
+
+#define N_FRAMES 20
+#define N_VISIBLE 4             // events on screen at the same time
+#define EVENT_LENGTH 1500       // characters per event
+#define FRAME_DURATION 1000
+
+#define N_COUNTERS 2
+
+static const char *counter_names[N_COUNTERS] = {
+    "cache misses", "L1d read misses",
+};
+
+static int counter_fds[N_COUNTERS] = { -1, -1 };
+
+static void msg_callback(int level, const char *fmt, va_list va, void *data)
+{
+    if (level > 1)
+        return;
+    printf("libass: ");
+    vprintf(fmt, va);
+    printf("\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void open_counters(void)
+{
+#ifdef __linux__
+    static const uint64_t configs[N_COUNTERS] = {
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+            PERF_COUNT_HW_CACHE_RESULT_MISS << 16,
+    };
+    static const uint32_t types[N_COUNTERS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+    };
+    int i;
+
+    for (i = 0; i < N_COUNTERS; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[i];
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        counter_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+static void start_counters(void)
+{
+#ifdef __linux__
+    int i;
+    for (i = 0; i < N_COUNTERS; ++i)
+        if (counter_fds[i] >= 0) {
+            ioctl(counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+}
+
+/**
+ * \brief Stop the counters and read them
+ * \param values counter values, -1 for unavailable counters
+ */
+static void stop_counters(long long *values)
+{
+    int i;
+    for (i = 0; i < N_COUNTERS; ++i) {
+        values[i] = -1;
+#ifdef __linux__
+        if (counter_fds[i] >= 0) {
+            uint64_t value;
+            ioctl(counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counter_fds[i], &value, sizeof(value)) ==
+                sizeof(value))
+                values[i] = value;
+        }
+#endif
+    }
+}
+
+#define LINE_OF(field) (1u << (offsetof(GlyphInfo, field) / 64))
+
+/**
+ * \brief Count the 64-byte lines of a GlyphInfo holding the fields read
+ * by measure_text, the wrapping code, compute_string_bbox and the
+ * positioning loops
+ */
+static int hot_lines(void)
+{
+    unsigned mask = LINE_OF(symbol) | LINE_OF(skip) | LINE_OF(asc) |
+        LINE_OF(desc) | LINE_OF(pos) | LINE_OF(cluster_advance) |
+        LINE_OF(linebreak) | LINE_OF(effect) | LINE_OF(next) |
+        LINE_OF(advance) | LINE_OF(offset) | LINE_OF(bbox) |
+        LINE_OF(fax) | LINE_OF(fay) | LINE_OF(scale_x) | LINE_OF(scale_y);
+    int n = 0;
+
+    for (; mask; mask &= mask - 1)
+        n++;
+    return n;
+}
+
+static char *make_script(size_t *script_size)
+{
+    static const char *words[] = {
+        "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dogs",
+        "while", "seven", "wizards", "quietly", "box", "{\\i1}jam{\\i0}",
+    };
+    size_t size = 4096 + N_FRAMES * N_VISIBLE * (EVENT_LENGTH + 256);
+    char *buf = malloc(size);
+    int len, i, k;
+
+    len = snprintf(buf, size,
+            "[Script Info]\n"
+            "ScriptType: v4.00+\n"
+            "PlayResX: 1280\n"
+            "PlayResY: 720\n"
+            "WrapStyle: 0\n"
+            "\n"
+            "[V4+ Styles]\n"
+            "Format: Name, Fontname, Fontsize, PrimaryColour, "
+            "SecondaryColour, OutlineColour, BackColour, Bold, Italic, "
+            "Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, "
+            "BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, "
+            "MarginV, Encoding\n"
+            "Style: Default,Sans,12,&H00FFFFFF,&H000000FF,&H00000000,"
+            "&H00000000,0,0,0,0,100,100,0,0,1,1,0,7,10,10,10,1\n"
+            "\n"
+            "[Events]\n"
+            "Format: Layer, Start, End, Style, Name, MarginL, MarginR, "
+            "MarginV, Effect, Text\n");
+
+    // N_VISIBLE long events per frame, each in its own quarter of the
+    // screen
+    for (i = 0; i < N_FRAMES * N_VISIBLE; ++i) {
+        int start = i / N_VISIBLE * FRAME_DURATION / 10;
+        int end = start + FRAME_DURATION / 10;
+        int text_start;
+        len += snprintf(buf + len, size - len,
+                "Dialogue: 0,0:%02d:%02d.%02d,0:%02d:%02d.%02d,Default,,"
+                "%d,%d,%d,,",
+                start / 6000, start / 100 % 60, start % 100,
+                end / 6000, end / 100 % 60, end % 100,
+                10 + 640 * (i % 2), 10 + 640 * (1 - i % 2),
+                10 + 360 * (i % N_VISIBLE / 2));
+        text_start = len;
+        for (k = i; len - text_start < EVENT_LENGTH; ++k)
+            len += snprintf(buf + len, size - len, "%s ",
+                            words[k * 7 % (sizeof(words) / sizeof(words[0]))]);
+        buf[len - 1] = '\n';
+    }
+
+    *script_size = len;
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 10, i, r;
+    ASS_Library *library;
+    ASS_Renderer *renderer;
+    ASS_Track *track;
+    long long values[N_COUNTERS], totals[N_COUNTERS];
+    double start, ms;
+    char *script;
+    size_t size;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+    if (rounds <= 0) {
+        printf("usage: %s [rounds]\n", argv[0]);
+        exit(1);
+    }
+
+    library = ass_library_init();
+    ass_set_message_cb(library, msg_callback, NULL);
+    renderer = ass_renderer_init(library);
+    ass_set_frame_size(renderer, 1280, 720);
+    ass_set_fonts(renderer, NULL, "Sans", 1, NULL, 1);
+    script = make_script(&size);
+    track = ass_read_memory(library, script, size, NULL);
+    if (!track) {
+        printf("track init failed!\n");
+        exit(1);
+    }
+
+    // warm up the caches
+    for (i = 0; i < N_FRAMES; ++i)
+        ass_render_frame(renderer, track,
+                         i * FRAME_DURATION + FRAME_DURATION / 2, NULL);
+
+    open_counters();
+    memset(totals, 0, sizeof(totals));
+    ms = 0;
+    for (r = 0; r < rounds; ++r)
+        for (i = 0; i < N_FRAMES; ++i) {
+            int k;
+            start = now();
+            start_counters();
+            ass_render_frame(renderer, track,
+                             i * FRAME_DURATION + FRAME_DURATION / 2, NULL);
+            stop_counters(values);
+            ms += now() - start;
+            for (k = 0; k < N_COUNTERS; ++k)
+                totals[k] = values[k] < 0 || totals[k] < 0 ? -1 :
+                            totals[k] + values[k];
+        }
+
+    printf("GlyphInfo: %d bytes, layout fields in %d cache lines\n",
+           (int) sizeof(GlyphInfo), hot_lines());
+    printf("%d frames of %d events, %d characters each, warm caches\n",
+           N_FRAMES, N_VISIBLE, EVENT_LENGTH);
+    printf("%-20s %12.4f\n", "frame, ms", ms / (rounds * N_FRAMES));
+    for (i = 0; i < N_COUNTERS; ++i) {
+        if (totals[i] < 0) {
+            printf("%-20s %12s\n", counter_names[i], "n/a");
+            continue;
+        }
+        printf("%-20s %12.0f  (%.3f per glyph)\n", counter_names[i],
+               (double) totals[i] / (rounds * N_FRAMES),
+               (double) totals[i] /
+               ((double) rounds * N_FRAMES * N_VISIBLE * EVENT_LENGTH));
+    }
+
+    ass_free_track(track);
+    ass_renderer_done(renderer);
+    ass_library_done(library);
+    free(script);
+
+    return 0;
+}
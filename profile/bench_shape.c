@@ -0,0 +1,204 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Shaping benchmark: renders frames whose events switch fonts and sizes
+ * from run to run, once with warm caches, and prints the heap allocations
+ * and the time per frame for each shaping level.  With warm caches almost
+ * all remaining allocations come from laying out the events, shaping
+ * included.  Allocations are counted by wrapping malloc, calloc and
+ * realloc at link time (-Wl,--wrap), which also catches the ones made by
+ * HarfBuzz and FriBidi when they are linked statically.  The benchmark is
+ * only built when configure finds a linker that supports --wrap.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "ass.h"
+
+#define N_FRAMES 50
+#define N_VISIBLE 6             // events on screen at the same time
+#define FRAME_DURATION 1000
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static unsigned long n_allocs;
+
+void *__wrap_malloc(size_t size)
+{
+    n_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    n_allocs++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    n_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+static const char *lines[] = {
+    "{\\fnSans}Short {\\fs40}runs {\\fnSerif}in {\\fs28}different "
+    "{\\fnMonospace}fonts {\\fs36}and sizes",
+    "{\\fnSerif\\fs44}Ligatures: office, affine, fjord, "
+    "{\\fnSans\\fs30}Kerning: AVATAR, Type, WAVE",
+    "{\\b1}Bold {\\i1}italic{\\b0} run{\\i0}, and \\Nsome plain text "
+    "on a second line",
+    "{\\fs24}مرحبا بالعالم {\\fs32}Hello {\\fs40}שלום עולם",
+    "{\\fscx120\\fscy80}Scaled {\\fscx80\\fscy120}both ways, "
+    "{\\fscx100\\fscy100\\fsp2}spaced out",
+};
+
+static void msg_callback(int level, const char *fmt, va_list va, void *data)
+{
+    if (level > 1)
+        return;
+    printf("libass: ");
+    vprintf(fmt, va);
+    printf("\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static char *make_script(size_t *script_size)
+{
+    size_t size = 4096 + N_FRAMES * N_VISIBLE * 512;
+    char *buf = malloc(size);
+    int len, i;
+
+    len = snprintf(buf, size,
+            "[Script Info]\n"
+            "ScriptType: v4.00+\n"
+            "PlayResX: 1280\n"
+            "PlayResY: 720\n"
+            "\n"
+            "[V4+ Styles]\n"
+            "Format: Name, Fontname, Fontsize, PrimaryColour, "
+            "SecondaryColour, OutlineColour, BackColour, Bold, Italic, "
+            "Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, "
+            "BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, "
+            "MarginV, Encoding\n"
+            "Style: Default,Sans,32,&H00FFFFFF,&H000000FF,&H00000000,"
+            "&H00000000,0,0,0,0,100,100,0,0,1,2,0,2,40,40,30,1\n"
+            "\n"
+            "[Events]\n"
+            "Format: Layer, Start, End, Style, Name, MarginL, MarginR, "
+            "MarginV, Effect, Text\n");
+
+    for (i = 0; i < N_FRAMES * N_VISIBLE; ++i) {
+        int start = i / N_VISIBLE * FRAME_DURATION / 10;
+        int end = start + FRAME_DURATION / 10;
+        len += snprintf(buf + len, size - len,
+                "Dialogue: 0,0:%02d:%02d.%02d,0:%02d:%02d.%02d,Default,,"
+                "0,0,0,,{\\an7\\pos(20,%d)}%s\n",
+                start / 6000, start / 100 % 60, start % 100,
+                end / 6000, end / 100 % 60, end % 100,
+                20 + 115 * (i % N_VISIBLE),
+                lines[i % (sizeof(lines) / sizeof(lines[0]))]);
+    }
+
+    *script_size = len;
+    return buf;
+}
+
+static void bench(const char *name, ASS_ShapingLevel level, int rounds,
+                  char *script, size_t size)
+{
+    ASS_Library *library = ass_library_init();
+    ASS_Renderer *renderer;
+    ASS_Track *track;
+    unsigned long allocs;
+    double start, ms;
+    int i, r;
+
+    ass_set_message_cb(library, msg_callback, NULL);
+    renderer = ass_renderer_init(library);
+    ass_set_frame_size(renderer, 1280, 720);
+    ass_set_fonts(renderer, NULL, "Sans", 1, NULL, 1);
+    ass_set_shaper(renderer, level);
+    track = ass_read_memory(library, script, size, NULL);
+    if (!track) {
+        printf("track init failed!\n");
+        exit(1);
+    }
+
+    // warm up the caches
+    for (i = 0; i < N_FRAMES; ++i)
+        ass_render_frame(renderer, track,
+                         i * FRAME_DURATION + FRAME_DURATION / 2, NULL);
+
+    allocs = n_allocs;
+    start = now();
+    for (r = 0; r < rounds; ++r)
+        for (i = 0; i < N_FRAMES; ++i)
+            ass_render_frame(renderer, track,
+                             i * FRAME_DURATION + FRAME_DURATION / 2, NULL);
+    ms = (now() - start) / (rounds * N_FRAMES);
+    allocs = n_allocs - allocs;
+
+    printf("%-10s %16.1f %12.1f %12.4f\n", name,
+           (double) allocs / (rounds * N_FRAMES),
+           (double) allocs / (rounds * N_FRAMES * N_VISIBLE), ms);
+
+    ass_free_track(track);
+    ass_renderer_done(renderer);
+    ass_library_done(library);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 10;
+    char *script;
+    size_t size;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+    if (rounds <= 0) {
+        printf("usage: %s [rounds]\n", argv[0]);
+        exit(1);
+    }
+
+    script = make_script(&size);
+
+    printf("%d frames, %d events each, warm caches\n", N_FRAMES, N_VISIBLE);
+    printf("%-10s %16s %12s %12s\n", "shaper", "allocs/frame",
+           "allocs/event", "frame, ms");
+    bench("simple", ASS_SHAPING_SIMPLE, rounds, script, size);
+#ifdef CONFIG_HARFBUZZ
+    bench("complex", ASS_SHAPING_COMPLEX, rounds, script, size);
+#endif
+
+    free(script);
+
+    return 0;
+}
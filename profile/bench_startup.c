@@ -0,0 +1,316 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Startup latency benchmark: measures the time to the first rendered
+ * subtitle, split into phases.  A temporary font directory is filled with
+ * copies of the given font file and used through its own fontconfig
+ * configuration, so the results do not depend on the system fonts.  Every
+ * round uses a fresh fontconfig cache directory, so the first ass_set_fonts
+ * call of a round always scans the fonts.  The script embeds copies of the
+ * font in its [Fonts] section.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <ass.h>
+
+#define N_PHASES 7
+
+static const char *phase_names[N_PHASES] = {
+    "library and renderer init",
+    "ass_set_fonts, cold cache",
+    "ass_set_fonts, warm cache",
+    "parse embedded fonts",
+    "ass_set_fonts, embedded",
+    "first frame",
+    "second frame",
+};
+
+static const char *families[] = {
+    "Sans", "Serif", "Bench Font 0", "Bench Font 1", "Arial",
+    "Times New Roman", "Comic Sans MS", "DejaVu Sans",
+};
+
+#define N_FAMILIES (sizeof(families) / sizeof(families[0]))
+
+static void msg_callback(int level, const char *fmt, va_list va, void *data)
+{
+    if (level > 1)
+        return;
+    printf("libass: ");
+    vprintf(fmt, va);
+    printf("\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static char *read_file(const char *fname, size_t *size)
+{
+    FILE *fp = fopen(fname, "rb");
+    char *buf;
+    long len;
+
+    if (!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    buf = malloc(len);
+    if (!buf || fread(buf, 1, len, fp) != len) {
+        free(buf);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    *size = len;
+    return buf;
+}
+
+static int write_file(const char *fname, const char *data, size_t size)
+{
+    FILE *fp = fopen(fname, "wb");
+    if (!fp)
+        return 1;
+    if (fwrite(data, 1, size, fp) != size) {
+        fclose(fp);
+        return 1;
+    }
+    return fclose(fp) != 0;
+}
+
+/**
+ * \brief Append data encoded like the [Fonts] section expects: every 3
+ * bytes become 4 characters of 6 bits plus 33, in lines of 80 characters
+ */
+static char *encode_font(char *dst, const unsigned char *src, size_t size)
+{
+    size_t i;
+    int col = 0, k, n;
+
+    for (i = 0; i < size; i += 3) {
+        unsigned value = src[i] << 16;
+        if (i + 1 < size)
+            value |= src[i + 1] << 8;
+        if (i + 2 < size)
+            value |= src[i + 2];
+        // a partial group only needs the characters covering its bytes
+        n = size - i >= 3 ? 4 : size - i + 1;
+        for (k = 0; k < n; ++k) {
+            *dst++ = ((value >> (18 - 6 * k)) & 63) + 33;
+            if (++col == 80) {
+                *dst++ = '\n';
+                col = 0;
+            }
+        }
+    }
+    *dst++ = '\n';
+    return dst;
+}
+
+static char *make_script(const char *font, size_t font_size, int n_embedded,
+                         int n_events, size_t *script_size)
+{
+    static const char header[] =
+        "[Script Info]\n"
+        "ScriptType: v4.00+\n"
+        "PlayResX: 1280\n"
+        "PlayResY: 720\n"
+        "\n"
+        "[V4+ Styles]\n"
+        "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, "
+        "OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, "
+        "ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, "
+        "Alignment, MarginL, MarginR, MarginV, Encoding\n"
+        "Style: Default,Sans,48,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,"
+        "0,0,0,0,100,100,0,0,1,2,1,2,40,40,30,1\n"
+        "\n"
+        "[Fonts]\n";
+    static const char events[] =
+        "\n"
+        "[Events]\n"
+        "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, "
+        "Effect, Text\n";
+    size_t encoded = font_size / 3 * 4 + 4;
+    size_t size = sizeof(header) + sizeof(events) +
+                  n_embedded * (64 + encoded + encoded / 80 + 2) +
+                  n_events * 256;
+    char *script = malloc(size);
+    char *p = script;
+    int i;
+
+    p += sprintf(p, "%s", header);
+    for (i = 0; i < n_embedded; ++i) {
+        p += sprintf(p, "fontname: bench%d_0.ttf\n", i);
+        p = encode_font(p, (const unsigned char *) font, font_size);
+    }
+    p += sprintf(p, "%s", events);
+    // every event asks for a different family and style, so every one of
+    // them goes through font selection on the first frame
+    for (i = 0; i < n_events; ++i)
+        p += sprintf(p, "Dialogue: 0,0:00:00.00,0:00:10.00,Default,,0,0,0,,"
+                     "{\\fn%s\\b%d\\i%d\\an%d}Startup %d\n",
+                     families[i % N_FAMILIES], (int) (i / N_FAMILIES) & 1,
+                     (int) (i / N_FAMILIES / 2) & 1, 1 + i % 9, i);
+
+    *script_size = p - script;
+    return script;
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int flag,
+                        struct FTW *ftwbuf)
+{
+    return remove(path);
+}
+
+static void run_round(const char *dir, int round, const char *script,
+                      size_t script_size, double *t)
+{
+    char config[4096], conf_text[8192];
+    ASS_Library *library;
+    ASS_Renderer *renderer;
+    ASS_Track *track;
+    double start;
+
+    // a new cache directory makes the first ass_set_fonts scan the fonts
+    snprintf(conf_text, sizeof(conf_text),
+             "<?xml version=\"1.0\"?>\n"
+             "<!DOCTYPE fontconfig SYSTEM \"fonts.dtd\">\n"
+             "<fontconfig>\n"
+             "  <dir>%s/fonts</dir>\n"
+             "  <cachedir>%s/cache%d</cachedir>\n"
+             "</fontconfig>\n", dir, dir, round);
+    snprintf(config, sizeof(config), "%s/fonts%d.conf", dir, round);
+    write_file(config, conf_text, strlen(conf_text));
+
+    start = now();
+    library = ass_library_init();
+    ass_set_message_cb(library, msg_callback, NULL);
+    renderer = ass_renderer_init(library);
+    ass_set_frame_size(renderer, 1280, 720);
+    t[0] = now() - start;
+
+    start = now();
+    ass_set_fonts(renderer, NULL, "Sans", 1, config, 1);
+    t[1] = now() - start;
+
+    ass_renderer_done(renderer);
+    renderer = ass_renderer_init(library);
+    ass_set_frame_size(renderer, 1280, 720);
+    start = now();
+    ass_set_fonts(renderer, NULL, "Sans", 1, config, 1);
+    t[2] = now() - start;
+
+    ass_set_extract_fonts(library, 1);
+    start = now();
+    track = ass_read_memory(library, (char *) script, script_size, NULL);
+    t[3] = now() - start;
+
+    // embedded fonts are only picked up by the next ass_set_fonts
+    start = now();
+    ass_set_fonts(renderer, NULL, "Sans", 1, config, 1);
+    t[4] = now() - start;
+
+    start = now();
+    ass_render_frame(renderer, track, 1000, NULL);
+    t[5] = now() - start;
+
+    start = now();
+    ass_render_frame(renderer, track, 2000, NULL);
+    t[6] = now() - start;
+
+    ass_free_track(track);
+    ass_renderer_done(renderer);
+    ass_library_done(library);
+}
+
+int main(int argc, char *argv[])
+{
+    char dir[] = "/tmp/ass-startup-XXXXXX";
+    char path[4096];
+    double t[N_PHASES], best[N_PHASES], sum[N_PHASES];
+    int n_fonts = 100, n_embedded = 4, n_events = 32, rounds = 5;
+    char *font, *script;
+    size_t font_size, script_size;
+    int i, r;
+
+    if (argc > 2)
+        n_fonts = atoi(argv[2]);
+    if (argc > 3)
+        n_embedded = atoi(argv[3]);
+    if (argc > 4)
+        rounds = atoi(argv[4]);
+    if (argc < 2 || n_fonts <= 0 || n_embedded < 0 || rounds <= 0) {
+        printf("usage: %s <font file> [fonts in directory] "
+               "[embedded fonts] [rounds]\n", argv[0]);
+        exit(1);
+    }
+
+    font = read_file(argv[1], &font_size);
+    if (!font) {
+        printf("cannot read %s\n", argv[1]);
+        exit(1);
+    }
+    if (!mkdtemp(dir)) {
+        printf("cannot create a temporary directory\n");
+        exit(1);
+    }
+    snprintf(path, sizeof(path), "%s/fonts", dir);
+    mkdir(path, 0700);
+    for (i = 0; i < n_fonts; ++i) {
+        snprintf(path, sizeof(path), "%s/fonts/font%03d.ttf", dir, i);
+        if (write_file(path, font, font_size)) {
+            printf("cannot write %s\n", path);
+            nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+            exit(1);
+        }
+    }
+    script = make_script(font, font_size, n_embedded, n_events, &script_size);
+
+    printf("%d fonts in directory, %d embedded, %d events, %d rounds\n",
+           n_fonts, n_embedded, n_events, rounds);
+    for (r = 0; r < rounds; ++r) {
+        run_round(dir, r, script, script_size, t);
+        for (i = 0; i < N_PHASES; ++i) {
+            if (!r || t[i] < best[i])
+                best[i] = t[i];
+            sum[i] = (r ? sum[i] : 0) + t[i];
+        }
+    }
+
+    printf("%-28s %10s %10s\n", "phase", "best ms", "mean ms");
+    for (i = 0; i < N_PHASES; ++i)
+        printf("%-28s %10.2f %10.2f\n", phase_names[i], best[i],
+               sum[i] / rounds);
+
+    nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    free(script);
+    free(font);
+
+    return 0;
+}
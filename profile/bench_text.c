@@ -0,0 +1,296 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Event text benchmark: compares reading event text from UTF-8 on every
+ * frame with reading it pre-decoded (ass_set_predecode_text).  Prints the
+ * time to load the track, the time to walk the characters of all events
+ * as the renderer does, and the time per frame with warm caches, and
+ * fails if the rendered images differ.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "ass_render.h"
+#include "ass_parse.h"
+
+#define N_EVENTS 400
+#define N_VISIBLE 8             // events on screen at the same time
+#define EVENT_DURATION 1000
+
+static const char *lines[] = {
+    "{\\k20}I {\\k35}told {\\k30}you {\\k40}al{\\k25}rea{\\k30}dy, "
+    "{\\k20}we {\\k30}are {\\k25}not {\\k40}go{\\k30}ing {\\k35}back.",
+    "Ты всегда так говоришь, но каждый раз кто-то приходит первым"
+    "\\Nи забирает всё самое ценное.",
+    "{\\i1}Fine.{\\i0} Pack the truck tonight, and if the radio still "
+    "says the bridge is open, we leave at dawn.",
+    "{\\fs40\\c&H00FFFF&}Ή γη και η θάλασσα{\\r}\\hδεν περιμένουν κανέναν.",
+};
+
+typedef struct {
+    ASS_Library *library;
+    ASS_Renderer *renderer;
+    ASS_Track *track;
+    double load_ms;
+} Setup;
+
+static void msg_callback(int level, const char *fmt, va_list va, void *data)
+{
+    if (level > 1)
+        return;
+    printf("libass: ");
+    vprintf(fmt, va);
+    printf("\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static char *make_script(size_t *script_size)
+{
+    size_t size = 4096 + N_EVENTS * 512;
+    char *buf = malloc(size);
+    int len, i;
+
+    len = snprintf(buf, size,
+            "[Script Info]\n"
+            "ScriptType: v4.00+\n"
+            "PlayResX: 1280\n"
+            "PlayResY: 720\n"
+            "\n"
+            "[V4+ Styles]\n"
+            "Format: Name, Fontname, Fontsize, PrimaryColour, "
+            "SecondaryColour, OutlineColour, BackColour, Bold, Italic, "
+            "Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, "
+            "BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, "
+            "MarginV, Encoding\n"
+            "Style: Default,Sans,32,&H00FFFFFF,&H000000FF,&H00000000,"
+            "&H00000000,0,0,0,0,100,100,0,0,1,2,0,2,40,40,30,1\n"
+            "\n"
+            "[Events]\n"
+            "Format: Layer, Start, End, Style, Name, MarginL, MarginR, "
+            "MarginV, Effect, Text\n");
+
+    // every frame shows N_VISIBLE events, each on its own line
+    for (i = 0; i < N_EVENTS; ++i) {
+        int start = i / N_VISIBLE * EVENT_DURATION / 10;
+        int end = start + EVENT_DURATION / 10;
+        len += snprintf(buf + len, size - len,
+                "Dialogue: 0,0:%02d:%02d.%02d,0:%02d:%02d.%02d,Default,,"
+                "0,0,0,,{\\an7\\pos(20,%d)}%s\n",
+                start / 6000, start / 100 % 60, start % 100,
+                end / 6000, end / 100 % 60, end % 100,
+                20 + 85 * (i % N_VISIBLE),
+                lines[i % (sizeof(lines) / sizeof(lines[0]))]);
+    }
+
+    *script_size = len;
+    return buf;
+}
+
+static void setup(Setup *s, int predecode, char *script, size_t size)
+{
+    double start;
+
+    s->library = ass_library_init();
+    ass_set_message_cb(s->library, msg_callback, NULL);
+    ass_set_predecode_text(s->library, predecode);
+    s->renderer = ass_renderer_init(s->library);
+    ass_set_frame_size(s->renderer, 1280, 720);
+    ass_set_fonts(s->renderer, NULL, "Sans", 1, NULL, 1);
+
+    start = now();
+    s->track = ass_read_memory(s->library, script, size, NULL);
+    s->load_ms = now() - start;
+    if (!s->track) {
+        printf("track init failed!\n");
+        exit(1);
+    }
+}
+
+static void done(Setup *s)
+{
+    ass_free_track(s->track);
+    ass_renderer_done(s->renderer);
+    ass_library_done(s->library);
+}
+
+/**
+ * \brief Walk the characters of all events from UTF-8, skipping override
+ * blocks, like the event loop of ass_render_event
+ */
+static unsigned walk_utf8(ASS_Renderer *renderer, ASS_Track *track)
+{
+    unsigned sum = 0;
+    int i;
+
+    for (i = 0; i < track->n_events; ++i) {
+        char *p = track->events[i].Text;
+        while (*p) {
+            if (*p == '{') {
+                char *end = strchr(p, '}');
+                p = end ? end + 1 : p + strlen(p);
+                continue;
+            }
+            sum += get_next_char(renderer, &p);
+        }
+    }
+    return sum;
+}
+
+static unsigned walk_decoded(ASS_Renderer *renderer, ASS_Track *track)
+{
+    unsigned sum = 0;
+    int i;
+
+    for (i = 0; i < track->n_events; ++i) {
+        DecodedText *decoded = ass_event_decoded_text(track->events + i);
+        uint32_t *u;
+        for (u = decoded->units; *u; ++u) {
+            if (*u & TEXT_TAGS)
+                ++u;            // skip the end offset
+            else if (*u == TEXT_SOFT_BREAK)
+                sum += ' ';
+            else
+                sum += *u;
+        }
+    }
+    return sum;
+}
+
+static double time_walk(unsigned (*walk)(ASS_Renderer *, ASS_Track *),
+                        Setup *s, int rounds, unsigned *sum)
+{
+    double start = now();
+    int r;
+
+    *sum = 0;
+    for (r = 0; r < rounds; ++r)
+        *sum += walk(s->renderer, s->track);
+    return (now() - start) * 1e3 / rounds;
+}
+
+static unsigned long long hash_images(ASS_Image *img)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    for (; img; img = img->next) {
+        int y;
+        h = (h ^ (img->dst_x + 65536ULL * img->dst_y)) * 1099511628211ULL;
+        h = (h ^ img->color) * 1099511628211ULL;
+        for (y = 0; y < img->h; ++y)
+            h = (h ^ ass_hash_buf(img->bitmap + y * img->stride, img->w,
+                                  ASS_HASH_INIT)) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * \brief Render every frame once
+ * \return hash of all images
+ */
+static unsigned long long render_all(Setup *s)
+{
+    unsigned long long hash = 0;
+    int i;
+
+    for (i = 0; i < N_EVENTS / N_VISIBLE; ++i)
+        hash += hash_images(ass_render_frame(s->renderer, s->track,
+                            i * EVENT_DURATION + EVENT_DURATION / 2,
+                            NULL));
+    return hash;
+}
+
+static double time_frames(Setup *s)
+{
+    double start = now();
+    int i;
+
+    for (i = 0; i < N_EVENTS / N_VISIBLE; ++i)
+        ass_render_frame(s->renderer, s->track,
+                         i * EVENT_DURATION + EVENT_DURATION / 2, NULL);
+    return now() - start;
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 10, failed = 0, r;
+    Setup utf8, decoded;
+    unsigned sum_utf8, sum_decoded;
+    unsigned long long hash_utf8, hash_decoded;
+    double walk_utf8_us, walk_decoded_us, frame_utf8, frame_decoded;
+    char *script;
+    size_t size;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+    if (rounds <= 0) {
+        printf("usage: %s [rounds]\n", argv[0]);
+        exit(1);
+    }
+
+    script = make_script(&size);
+    setup(&utf8, 0, script, size);
+    setup(&decoded, 1, script, size);
+
+    walk_utf8_us = time_walk(walk_utf8, &utf8, 100 * rounds, &sum_utf8);
+    walk_decoded_us = time_walk(walk_decoded, &decoded, 100 * rounds,
+                                &sum_decoded);
+    // the first round warms up the caches; alternate the rest, so both
+    // see the same system noise
+    hash_utf8 = render_all(&utf8);
+    hash_decoded = render_all(&decoded);
+    frame_utf8 = frame_decoded = 0;
+    for (r = 0; r < rounds; ++r) {
+        frame_utf8 += time_frames(&utf8);
+        frame_decoded += time_frames(&decoded);
+    }
+    frame_utf8 /= rounds * (N_EVENTS / N_VISIBLE);
+    frame_decoded /= rounds * (N_EVENTS / N_VISIBLE);
+
+    printf("%d events, %d on screen\n", N_EVENTS, N_VISIBLE);
+    printf("%-24s %12s %12s\n", "", "utf-8", "pre-decoded");
+    printf("%-24s %12.2f %12.2f\n", "load track, ms", utf8.load_ms,
+           decoded.load_ms);
+    printf("%-24s %12.2f %12.2f\n", "walk all events, us", walk_utf8_us,
+           walk_decoded_us);
+    printf("%-24s %12.4f %12.4f\n", "frame, ms", frame_utf8,
+           frame_decoded);
+    if (sum_utf8 != sum_decoded) {
+        printf("decoded characters differ\n");
+        failed = 1;
+    }
+    if (hash_utf8 != hash_decoded) {
+        printf("rendered images differ\n");
+        failed = 1;
+    }
+
+    done(&utf8);
+    done(&decoded);
+    free(script);
+
+    return failed;
+}
@@ -0,0 +1,163 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Line wrapping benchmark: renders typical 2-3 line dialogue with
+ * WrapStyle 0 (minimum raggedness breaker) and WrapStyle 3 (greedy
+ * wrapping plus pairwise balancing) and prints the time per frame.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <ass.h>
+
+#define N_EVENTS 200
+#define EVENT_DURATION 100
+
+static const char *lines[] = {
+    "I told you already, we are not going back there until the storm "
+    "has passed and the roads are clear again.",
+    "You always say that, but every single time we wait, somebody else "
+    "gets there first and takes everything worth having.",
+    "Fine. Pack the truck tonight, and if the radio still says the "
+    "bridge is open in the morning, we leave at dawn without arguing "
+    "about it any further.",
+    "Short line.",
+};
+
+ASS_Library *ass_library;
+ASS_Renderer *ass_renderer;
+
+void msg_callback(int level, const char *fmt, va_list va, void *data)
+{
+    if (level > 6)
+        return;
+    printf("libass: ");
+    vprintf(fmt, va);
+    printf("\n");
+}
+
+static void init(int frame_w, int frame_h)
+{
+    ass_library = ass_library_init();
+    if (!ass_library) {
+        printf("ass_library_init failed!\n");
+        exit(1);
+    }
+
+    ass_set_message_cb(ass_library, msg_callback, NULL);
+
+    ass_renderer = ass_renderer_init(ass_library);
+    if (!ass_renderer) {
+        printf("ass_renderer_init failed!\n");
+        exit(1);
+    }
+
+    ass_set_frame_size(ass_renderer, frame_w, frame_h);
+    ass_set_fonts(ass_renderer, NULL, "Sans", 1, NULL, 1);
+}
+
+static ASS_Track *make_track(int wrap_style)
+{
+    size_t size = 4096 + N_EVENTS * 512;
+    char *buf = malloc(size);
+    int len, i;
+    ASS_Track *track;
+
+    len = snprintf(buf, size,
+            "[Script Info]\n"
+            "ScriptType: v4.00+\n"
+            "PlayResX: 1280\n"
+            "PlayResY: 720\n"
+            "WrapStyle: %d\n"
+            "\n"
+            "[V4+ Styles]\n"
+            "Format: Name, Fontname, Fontsize, PrimaryColour, "
+            "SecondaryColour, OutlineColour, BackColour, Bold, Italic, "
+            "Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, "
+            "BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, "
+            "MarginV, Encoding\n"
+            "Style: Default,Sans,48,&H00FFFFFF,&H000000FF,&H00000000,"
+            "&H00000000,0,0,0,0,100,100,0,0,1,2,0,2,40,40,30,1\n"
+            "\n"
+            "[Events]\n"
+            "Format: Layer, Start, End, Style, Name, MarginL, MarginR, "
+            "MarginV, Effect, Text\n", wrap_style);
+
+    for (i = 0; i < N_EVENTS; ++i) {
+        int start = i * EVENT_DURATION / 10;
+        int end = start + EVENT_DURATION / 10;
+        len += snprintf(buf + len, size - len,
+                "Dialogue: 0,0:00:%02d.%02d,0:00:%02d.%02d,Default,,"
+                "0,0,0,,%s\n", start / 100, start % 100, end / 100,
+                end % 100, lines[i % (sizeof(lines) / sizeof(lines[0]))]);
+    }
+
+    track = ass_read_memory(ass_library, buf, len, NULL);
+    free(buf);
+    if (!track) {
+        printf("track init failed!\n");
+        exit(1);
+    }
+    return track;
+}
+
+static double run(int wrap_style, int rounds)
+{
+    ASS_Track *track = make_track(wrap_style);
+    clock_t start;
+    int i, r;
+
+    // warm up glyph caches so only layout differs between runs
+    for (i = 0; i < N_EVENTS; ++i)
+        ass_render_frame(ass_renderer, track,
+                         i * EVENT_DURATION + EVENT_DURATION / 2, NULL);
+
+    start = clock();
+    for (r = 0; r < rounds; ++r)
+        for (i = 0; i < N_EVENTS; ++i)
+            ass_render_frame(ass_renderer, track,
+                             i * EVENT_DURATION + EVENT_DURATION / 2, NULL);
+
+    ass_free_track(track);
+    return (double) (clock() - start) * 1000. / CLOCKS_PER_SEC /
+           (rounds * N_EVENTS);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 10;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+    if (rounds <= 0) {
+        printf("usage: %s [rounds]\n", argv[0]);
+        exit(1);
+    }
+
+    init(1280, 720);
+
+    printf("WrapStyle 0 (balanced):  %.4f ms/frame\n", run(0, rounds));
+    printf("WrapStyle 3 (pairwise):  %.4f ms/frame\n", run(3, rounds));
+
+    ass_renderer_done(ass_renderer);
+    ass_library_done(ass_library);
+
+    return 0;
+}
@@ -0,0 +1,718 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Rendering consistency test.  Every case renders the same subtitles in
+ * two ways that have to agree, for example with and without a cache
+ * limit, and compares the blended frames exactly.
+ *
+ * Text is rendered with the font of the regression test and fontconfig
+ * disabled, so every font name selects that font.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ass.h>
+
+#define FRAME_W 640
+#define FRAME_H 360
+#define FONT_FILE "golden/fonts/Lato-Regular.ttf"
+
+typedef struct {
+    unsigned char buffer[FRAME_H][FRAME_W * 3];
+} Frame;
+
+static ASS_Library *library;
+static char font_path[4096];
+
+static const char header[] =
+    "[Script Info]\n"
+    "ScriptType: v4.00+\n"
+    "PlayResX: 640\n"
+    "PlayResY: 360\n"
+    "\n"
+    "[V4+ Styles]\n"
+    "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, "
+    "OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, "
+    "ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, "
+    "Alignment, MarginL, MarginR, MarginV, Encoding\n"
+    "Style: Default,Sans,28,&H00FFFFFF,&H000000FF,&H00000000,&H80000000,"
+    "0,0,0,0,100,100,0,0,1,2,1,2,20,20,20,1\n"
+    "\n"
+    "[Events]\n"
+    "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, "
+    "Effect, Text\n";
+
+static void msg_callback(int level, const char *fmt, va_list va, void *data)
+{
+    if (level > 1)
+        return;
+    printf("libass: ");
+    vprintf(fmt, va);
+    printf("\n");
+}
+
+static ASS_Renderer *new_renderer(void)
+{
+    ASS_Renderer *renderer = ass_renderer_init(library);
+    if (!renderer)
+        return NULL;
+    ass_set_frame_size(renderer, FRAME_W, FRAME_H);
+    ass_set_fonts(renderer, font_path, NULL, 0, NULL, 0);
+    ass_set_shaper(renderer, ASS_SHAPING_SIMPLE);
+    return renderer;
+}
+
+/**
+ * \brief Create a track from a header and some event lines
+ */
+static ASS_Track *new_track_with_header(const char *header,
+                                        const char *events)
+{
+    ASS_Track *track = ass_new_track(library);
+    if (!track)
+        return NULL;
+    ass_process_data(track, (char *) header, strlen(header));
+    ass_process_data(track, (char *) events, strlen(events));
+    return track;
+}
+
+/**
+ * \brief Create a track from the header above and some event lines
+ */
+static ASS_Track *new_track(const char *events)
+{
+    return new_track_with_header(header, events);
+}
+
+/**
+ * \brief Blend images on top of a frame
+ */
+static void blend_over(Frame *frame, ASS_Image *img)
+{
+    for (; img; img = img->next) {
+        unsigned opacity = 255 - (img->color & 0xFF);
+        unsigned char *src = img->bitmap;
+        int x, y, c;
+        for (y = 0; y < img->h; ++y) {
+            unsigned char *dst = frame->buffer[img->dst_y + y] +
+                                 img->dst_x * 3;
+            for (x = 0; x < img->w; ++x) {
+                unsigned k = src[x] * opacity / 255;
+                for (c = 0; c < 3; ++c) {
+                    unsigned v = (img->color >> (8 * (3 - c))) & 0xFF;
+                    dst[3 * x + c] =
+                        (k * v + (255 - k) * dst[3 * x + c]) / 255;
+                }
+            }
+            src += img->stride;
+        }
+    }
+}
+
+static void blend(Frame *frame, ASS_Image *img)
+{
+    memset(frame, 0, sizeof(*frame));
+    blend_over(frame, img);
+}
+
+static Frame frame_a, frame_b;
+
+/**
+ * \brief Font cache limit: a track using many more fonts than the limit,
+ * a few at a time, has to render exactly as with the default limit.
+ * Fonts drawn in the previous frame must stay cached along with their
+ * glyphs, and eviction must not flush the glyph caches.
+ */
+static int test_font_cache_limit(void)
+{
+    ASS_Renderer *limited = new_renderer();
+    ASS_Renderer *reference = new_renderer();
+    ASS_Track *track;
+    ASS_CacheStats stats;
+    char events[8192];
+    unsigned flushes;
+    int i, len = 0, failed = 0;
+
+    // 24 fonts, each shown for 400 ms, a new one every 100 ms
+    for (i = 0; i < 24; ++i)
+        len += snprintf(events + len, sizeof(events) - len,
+                "Dialogue: 0,0:00:%02d.%d0,0:00:%02d.%d0,Default,,"
+                "0,0,0,,{\\fnFamily %d\\pos(%d,%d)}Font number %d\n",
+                i / 10, i % 10, (i + 4) / 10, (i + 4) % 10,
+                i, 160 + 320 * (i & 1), 60 + 80 * (i / 2 % 4), i);
+    track = new_track(events);
+    if (!limited || !reference || !track)
+        return 1;
+    ass_set_font_cache_limits(limited, 6, 0);
+
+    for (i = 0; i < 28 && !failed; ++i) {
+        long long t = i * 100 + 50;
+        unsigned misses[2];
+
+        ass_get_cache_stats(limited, ASS_CACHE_OUTLINE, &stats);
+        misses[0] = stats.misses;
+        ass_get_cache_stats(reference, ASS_CACHE_OUTLINE, &stats);
+        misses[1] = stats.misses;
+
+        blend(&frame_a, ass_render_frame(limited, track, t, NULL));
+        blend(&frame_b, ass_render_frame(reference, track, t, NULL));
+        if (memcmp(&frame_a, &frame_b, sizeof(frame_a))) {
+            printf("frame at %lld ms differs\n", t);
+            failed = 1;
+        }
+
+        // only glyphs of fonts new to this frame may be missing
+        ass_get_cache_stats(limited, ASS_CACHE_OUTLINE, &stats);
+        misses[0] = stats.misses - misses[0];
+        ass_get_cache_stats(reference, ASS_CACHE_OUTLINE, &stats);
+        misses[1] = stats.misses - misses[1];
+        if (misses[0] != misses[1]) {
+            printf("frame at %lld ms: %u outline misses, %u expected\n",
+                   t, misses[0], misses[1]);
+            failed = 1;
+        }
+    }
+
+    ass_get_cache_stats(limited, ASS_CACHE_FONT, &stats);
+    if (stats.items > 6) {
+        printf("%u fonts cached, limit is 6\n", stats.items);
+        failed = 1;
+    }
+    ass_get_cache_stats(limited, ASS_CACHE_OUTLINE, &stats);
+    flushes = stats.flushes;
+    ass_get_cache_stats(limited, ASS_CACHE_BITMAP, &stats);
+    flushes += stats.flushes;
+    if (flushes) {
+        printf("glyph caches were flushed %u times\n", flushes);
+        failed = 1;
+    }
+
+    ass_free_track(track);
+    ass_renderer_done(limited);
+    ass_renderer_done(reference);
+    return failed;
+}
+
+/**
+ * \brief Render a frame with a new renderer, for comparison with a
+ * renderer that has state from earlier frames
+ */
+static void render_fresh(Frame *frame, ASS_Track *track, long long t)
+{
+    ASS_Renderer *renderer = new_renderer();
+    if (!renderer) {
+        memset(frame, 0, sizeof(*frame));
+        return;
+    }
+    blend(frame, ass_render_frame(renderer, track, t, NULL));
+    ass_renderer_done(renderer);
+}
+
+/**
+ * \brief Style edits: a style changed between two frames, through
+ * ass_process_force_style or directly, has to take effect in the second
+ * frame, for all events that use it.
+ */
+static int test_style_edit(void)
+{
+    static const char events[] =
+        "Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,,First line\n"
+        "Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,,Second line\n"
+        "Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,,Third line\n";
+    char *overrides[] = { "Default.PrimaryColour=&H0000FF00", NULL };
+    ASS_Renderer *renderer = new_renderer();
+    ASS_Track *track = new_track(events);
+    int i, failed = 0;
+
+    if (!renderer || !track)
+        return 1;
+
+    blend(&frame_a, ass_render_frame(renderer, track, 1000, NULL));
+
+    ass_set_style_overrides(library, overrides);
+    ass_process_force_style(track);
+    ass_set_style_overrides(library, NULL);
+    blend(&frame_b, ass_render_frame(renderer, track, 1000, NULL));
+    if (!memcmp(&frame_a, &frame_b, sizeof(frame_a))) {
+        printf("ass_process_force_style had no effect\n");
+        failed = 1;
+    }
+    render_fresh(&frame_a, track, 1000);
+    if (memcmp(&frame_a, &frame_b, sizeof(frame_a))) {
+        printf("frame after ass_process_force_style differs\n");
+        failed = 1;
+    }
+
+    for (i = 0; i < track->n_styles; ++i)
+        if (!strcmp(track->styles[i].Name, "Default"))
+            track->styles[i].FontSize = 40;
+    blend(&frame_b, ass_render_frame(renderer, track, 1000, NULL));
+    if (!memcmp(&frame_a, &frame_b, sizeof(frame_a))) {
+        printf("editing the style had no effect\n");
+        failed = 1;
+    }
+    render_fresh(&frame_a, track, 1000);
+    if (memcmp(&frame_a, &frame_b, sizeof(frame_a))) {
+        printf("frame after editing the style differs\n");
+        failed = 1;
+    }
+
+    ass_free_track(track);
+    ass_renderer_done(renderer);
+    return failed;
+}
+
+static int cmp_time(const void *a, const void *b)
+{
+    long long t1 = *(const long long *) a;
+    long long t2 = *(const long long *) b;
+    return (t1 > t2) - (t1 < t2);
+}
+
+/**
+ * \brief Overwrite a file with a prefix of data, optionally with some
+ * bytes at the end of it set to 0xFF
+ */
+static int write_file(const char *fname, const char *data, size_t size,
+                      size_t garbage)
+{
+    FILE *fp = fopen(fname, "wb");
+    int ok;
+
+    if (!fp)
+        return 0;
+    ok = !size || fwrite(data, size - garbage, 1, fp) == 1;
+    while (garbage--)
+        ok &= fputc(0xFF, fp) != EOF;
+    return !fclose(fp) && ok;
+}
+
+static char *read_file(const char *fname, size_t *size)
+{
+    FILE *fp = fopen(fname, "rb");
+    char *data;
+    long len;
+
+    if (!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    data = len > 0 ? malloc(len) : NULL;
+    if (data && fread(data, len, 1, fp) != 1) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    *size = len;
+    return data;
+}
+
+/**
+ * \brief Pre-rendered files: a track exported with ass_prerender_track
+ * has to play back exactly like ass_render_frame at the times it was
+ * sampled at, which are the event boundaries and multiples of the step
+ * in between.  Truncated and corrupt files must be rejected.
+ */
+static int test_prerender(void)
+{
+    static const char events[] =
+        "Dialogue: 0,0:00:00.00,0:00:01.00,Default,,0,0,0,,Static line\n"
+        "Dialogue: 0,0:00:00.50,0:00:01.50,Default,,0,0,0,,"
+        "{\\fad(200,200)}Fading line\n"
+        "Dialogue: 0,0:00:01.20,0:00:02.00,Default,,0,0,0,,"
+        "{\\move(100,100,500,300)}Moving line\n"
+        "Dialogue: 0,0:00:03.00,0:00:03.33,Default,,0,0,0,,After a gap\n";
+    const char *fname = "consistency-prerender.tmp";
+    const int step = 40;
+    ASS_Renderer *renderer = new_renderer();
+    ASS_Track *track = new_track(events);
+    ASS_Prerendered *p;
+    long long *times, end = 0;
+    int n_times = 0, i, failed = 0;
+    size_t size;
+    char *data;
+
+    if (!renderer || !track)
+        return 1;
+    if (ass_prerender_track(renderer, track, fname, step)) {
+        printf("ass_prerender_track failed\n");
+        return 1;
+    }
+    ass_renderer_done(renderer);
+
+    // the sampling of ass_prerender_track, so that collision detection
+    // sees the same history
+    for (i = 0; i < track->n_events; ++i) {
+        ASS_Event *event = track->events + i;
+        if (end < event->Start + event->Duration)
+            end = event->Start + event->Duration;
+    }
+    times = malloc((2 * track->n_events + end / step) * sizeof(*times));
+    if (!times)
+        return 1;
+    for (i = 0; i < track->n_events; ++i) {
+        times[n_times++] = track->events[i].Start;
+        times[n_times++] = track->events[i].Start + track->events[i].Duration;
+    }
+    for (i = step; i < end; i += step)
+        times[n_times++] = i;
+    qsort(times, n_times, sizeof(*times), cmp_time);
+
+    p = ass_prerendered_open(fname);
+    renderer = new_renderer();
+    if (!p || !renderer) {
+        printf("cannot open %s\n", fname);
+        failed = 1;
+    }
+    for (i = 0; !failed && i < n_times; ++i) {
+        if (i && times[i] == times[i - 1])
+            continue;
+        blend(&frame_a, ass_prerendered_get(p, times[i]));
+        blend(&frame_b, ass_render_frame(renderer, track, times[i], NULL));
+        if (memcmp(&frame_a, &frame_b, sizeof(frame_a))) {
+            printf("frame at %lld ms differs\n", times[i]);
+            failed = 1;
+        }
+    }
+    ass_prerendered_close(p);
+    if (renderer)
+        ass_renderer_done(renderer);
+    free(times);
+
+    data = read_file(fname, &size);
+    if (!data) {
+        printf("cannot read %s\n", fname);
+        failed = 1;
+    }
+    for (i = 0; data && i < 5; ++i) {
+        // truncated at several points, or with a garbled index
+        static const size_t cut[] = { 0, 8, 64 };
+        size_t len = i < 3 && cut[i] < size ? cut[i] : size - (i == 3);
+        size_t garbage = i == 4 ? 16 : 0;
+        if (!write_file(fname, data, len, garbage)) {
+            printf("cannot write %s\n", fname);
+            failed = 1;
+            break;
+        }
+        p = ass_prerendered_open(fname);
+        if (p) {
+            printf("damaged file %d was accepted\n", i);
+            ass_prerendered_close(p);
+            failed = 1;
+        }
+    }
+    free(data);
+    remove(fname);
+
+    ass_free_track(track);
+    return failed;
+}
+
+/**
+ * \brief Compare a frame rendered for a rectangle with a full frame
+ * \return 0 if they agree inside the rectangle and the partial frame is
+ * empty outside of it
+ */
+static int cmp_rect(const Frame *full, const Frame *part,
+                    int x0, int y0, int x1, int y1)
+{
+    int x, y;
+
+    for (y = 0; y < FRAME_H; ++y)
+        for (x = 0; x < FRAME_W * 3; ++x) {
+            int inside = y >= y0 && y < y1 && x >= 3 * x0 && x < 3 * x1;
+            unsigned char expected = inside ? full->buffer[y][x] : 0;
+            if (part->buffer[y][x] != expected)
+                return 1;
+        }
+    return 0;
+}
+
+/**
+ * \brief Region of interest: inside the rectangle, ass_render_frame_roi
+ * has to render exactly what ass_render_frame does, for events that are
+ * cut by the rectangle, pushed into or out of it by collision detection,
+ * or only reach it with their border, shadow or blur.
+ */
+static int test_roi(void)
+{
+    static const char events[] =
+        "Dialogue: 0,0:00:00.00,0:00:02.00,Default,,0,0,0,,"
+        "A long bottom line that collides with the ones below\n"
+        "Dialogue: 0,0:00:00.30,0:00:02.00,Default,,0,0,0,,"
+        "Second line of the stack\n"
+        "Dialogue: 0,0:00:00.60,0:00:02.00,Default,,0,0,0,,"
+        "Third line of the stack, a bit longer than the second\n"
+        "Dialogue: 0,0:00:00.90,0:00:01.50,Default,,0,0,0,,"
+        "Fourth\n"
+        "Dialogue: 0,0:00:00.00,0:00:02.00,Default,,0,0,0,,"
+        "{\\pos(320,60)\\bord3\\shad4\\3c&HFF8000&\\4c&H00FF00&\\4a&H00&}"
+        "Border and shadow across the edge\n"
+        "Dialogue: 0,0:00:00.00,0:00:02.00,Default,,0,0,0,,"
+        "{\\pos(320,140)\\bord0\\blur6}Blurred text across the edge\n"
+        "Dialogue: 0,0:00:00.00,0:00:02.00,Default,,0,0,0,,"
+        "{\\an7\\pos(180,160)\\p1}m 0 0 l 100 0 100 40 0 40\n"
+        "Dialogue: 1,0:00:00.00,0:00:02.00,Default,,0,0,0,,"
+        "{\\move(0,200,640,200)}Moving into and out of the rectangle\n";
+    static const int roi[][4] = {
+        { 200, 0, 440, 360 },       // vertical strip through everything
+        { 0, 200, 640, 290 },       // band above the bottom line
+        { 330, 40, 350, 80 },       // a few glyphs of one line
+        { 0, 62, 640, 100 },        // only border and shadow of a line
+        { 0, 100, 640, 114 },       // only blur of a line
+        { 0, 0, 100, 30 },          // nothing
+        { 0, 0, FRAME_W, FRAME_H },
+    };
+    enum { N_ROI = sizeof(roi) / sizeof(roi[0]) };
+    ASS_Renderer *full = new_renderer();
+    ASS_Renderer *part[N_ROI];
+    ASS_Track *track = new_track(events);
+    int i, t, failed = 0;
+
+    for (i = 0; i < N_ROI; ++i)
+        part[i] = new_renderer();
+    for (i = 0; i < N_ROI; ++i)
+        if (!part[i])
+            return 1;
+    if (!full || !track)
+        return 1;
+
+    for (t = 0; t <= 2000 && !failed; t += 125) {
+        blend(&frame_a, ass_render_frame(full, track, t, NULL));
+        for (i = 0; i < N_ROI; ++i) {
+            blend(&frame_b, ass_render_frame_roi(part[i], track, t, NULL,
+                                                 roi[i][0], roi[i][1],
+                                                 roi[i][2], roi[i][3]));
+            if (cmp_rect(&frame_a, &frame_b, roi[i][0], roi[i][1],
+                         roi[i][2], roi[i][3])) {
+                printf("frame at %d ms differs in rectangle %d\n", t, i);
+                failed = 1;
+            }
+        }
+    }
+
+    ass_free_track(track);
+    for (i = 0; i < N_ROI; ++i)
+        ass_renderer_done(part[i]);
+    ass_renderer_done(full);
+    return failed;
+}
+
+/**
+ * \brief Several tracks: ass_render_frame_multi has to draw each track as
+ * if it was rendered alone, with its own PlayRes, border scaling and
+ * styles for \r, and order the images by layer before track.
+ */
+static int test_multi(void)
+{
+    static const char header_a[] =
+        "[Script Info]\n"
+        "ScriptType: v4.00+\n"
+        "PlayResX: 640\n"
+        "PlayResY: 360\n"
+        "\n"
+        "[V4+ Styles]\n"
+        "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, "
+        "OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, "
+        "ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, "
+        "Alignment, MarginL, MarginR, MarginV, Encoding\n"
+        "Style: Default,Sans,28,&H00FFFFFF,&H000000FF,&H00FF0000,&H80000000,"
+        "0,0,0,0,100,100,0,0,1,2,1,2,20,20,20,1\n"
+        "Style: Alt,Sans,20,&H000000FF,&H000000FF,&H00000000,&H80000000,"
+        "1,0,0,0,100,100,0,0,1,1,0,2,20,20,20,1\n"
+        "\n"
+        "[Events]\n"
+        "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, "
+        "Effect, Text\n";
+    static const char header_b[] =
+        "[Script Info]\n"
+        "ScriptType: v4.00+\n"
+        "PlayResX: 1280\n"
+        "PlayResY: 720\n"
+        "ScaledBorderAndShadow: no\n"
+        "\n"
+        "[V4+ Styles]\n"
+        "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, "
+        "OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, "
+        "ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, "
+        "Alignment, MarginL, MarginR, MarginV, Encoding\n"
+        "Style: Default,Sans,48,&H0000FFFF,&H000000FF,&H000080FF,&H80000000,"
+        "0,0,0,0,100,100,0,0,1,3,2,8,40,40,40,1\n"
+        "Style: Alt,Sans,64,&H00FFFF00,&H000000FF,&H00000000,&H80000000,"
+        "0,1,0,0,100,100,0,0,1,4,0,8,40,40,40,1\n"
+        "\n"
+        "[Events]\n"
+        "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, "
+        "Effect, Text\n";
+    // the events of a are above those of b, and the boxes overlap; a
+    // simple event is the last of a and the first of b, so that the reset
+    // context kept for simple events would carry over between the tracks
+    static const char events_a[] =
+        "Dialogue: 1,0:00:00.00,0:00:02.00,Default,,0,0,0,,"
+        "{\\an7\\pos(300,150)\\bord0\\shad0\\1c&H0000FF&\\p1}"
+        "m 0 0 l 100 0 100 100 0 100\n"
+        "Dialogue: 1,0:00:00.00,0:00:02.00,Default,,0,0,0,,"
+        "Bottom line {\\rAlt}reset to Alt\n"
+        "Dialogue: 1,0:00:00.50,0:00:01.50,Default,,0,0,0,,"
+        "Pushed up by the bottom line\n";
+    static const char events_b[] =
+        "Dialogue: 0,0:00:00.00,0:00:02.00,Default,,0,0,0,,"
+        "Top line\n"
+        "Dialogue: 0,0:00:01.00,0:00:02.00,Default,,0,0,0,,"
+        "Pushed down {\\rAlt}and reset to Alt\n"
+        "Dialogue: 0,0:00:00.00,0:00:02.00,Default,,0,0,0,,"
+        "{\\an7\\pos(560,260)\\bord0\\shad0\\1c&H00FF00&\\p1}"
+        "m 0 0 l 200 0 200 200 0 200\n"
+        "Dialogue: 0,0:00:00.00,0:00:02.00,Default,,0,0,0,,"
+        "{\\an2\\pos(640,700)}Under the bottom line\n";
+    ASS_Renderer *multi = new_renderer();
+    ASS_Renderer *alone[2] = { new_renderer(), new_renderer() };
+    ASS_Track *tracks[2] = {
+        new_track_with_header(header_a, events_a),
+        new_track_with_header(header_b, events_b),
+    };
+    ASS_Track *reversed[2];
+    int t, failed = 0;
+
+    if (!multi || !alone[0] || !alone[1] || !tracks[0] || !tracks[1])
+        return 1;
+    reversed[0] = tracks[1];
+    reversed[1] = tracks[0];
+
+    for (t = 0; t <= 2000 && !failed; t += 250) {
+        // b is drawn first, because its events have the lower layer
+        blend(&frame_b, ass_render_frame(alone[1], tracks[1], t, NULL));
+        blend_over(&frame_b, ass_render_frame(alone[0], tracks[0], t, NULL));
+
+        blend(&frame_a, ass_render_frame_multi(multi, tracks, 2, t, NULL));
+        if (memcmp(&frame_a, &frame_b, sizeof(frame_a))) {
+            printf("frame at %d ms differs\n", t);
+            failed = 1;
+        }
+        blend(&frame_a, ass_render_frame_multi(multi, reversed, 2, t, NULL));
+        if (memcmp(&frame_a, &frame_b, sizeof(frame_a))) {
+            printf("frame at %d ms differs with the tracks reversed\n", t);
+            failed = 1;
+        }
+    }
+
+    ass_free_track(tracks[0]);
+    ass_free_track(tracks[1]);
+    ass_renderer_done(alone[0]);
+    ass_renderer_done(alone[1]);
+    ass_renderer_done(multi);
+    return failed;
+}
+
+/**
+ * \brief Text edits: with pre-decoded text, an event whose Text was
+ * modified in place or replaced, followed by ass_invalidate_event_text,
+ * has to render like the new text decoded from scratch.
+ */
+static int test_text_edit(void)
+{
+    static const char events[] =
+        "Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,,"
+        "{\\i1}Original text, long enough for the edits\n"
+        "Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,,Second line\n";
+    // in place, first with an override block of the original size, so
+    // that the old offsets would still fit, then as a new string
+    static const char *edits[] = {
+        "{\\b1}Same block, other text",
+        "Plain text in place",
+        "Replaced by a {\\b1}new string\\Nwith two lines",
+    };
+    ASS_Renderer *renderer;
+    ASS_Track *track;
+    int i, failed = 0;
+
+    ass_set_predecode_text(library, 1);
+    renderer = new_renderer();
+    track = new_track(events);
+    if (!renderer || !track)
+        return 1;
+
+    blend(&frame_a, ass_render_frame(renderer, track, 1000, NULL));
+    for (i = 0; i < sizeof(edits) / sizeof(edits[0]); ++i) {
+        ASS_Event *event = track->events;
+        if (i < 2)
+            strcpy(event->Text, edits[i]);
+        else {
+            free(event->Text);
+            event->Text = strdup(edits[i]);
+        }
+        ass_invalidate_event_text(track, 0);
+
+        blend(&frame_b, ass_render_frame(renderer, track, 1000, NULL));
+        if (!memcmp(&frame_a, &frame_b, sizeof(frame_a))) {
+            printf("edit %d had no effect\n", i);
+            failed = 1;
+        }
+        ass_set_predecode_text(library, 0);
+        render_fresh(&frame_a, track, 1000);
+        ass_set_predecode_text(library, 1);
+        if (memcmp(&frame_a, &frame_b, sizeof(frame_a))) {
+            printf("frame after edit %d differs\n", i);
+            failed = 1;
+        }
+    }
+    ass_set_predecode_text(library, 0);
+
+    ass_free_track(track);
+    ass_renderer_done(renderer);
+    return failed;
+}
+
+static const struct {
+    const char *name;
+    int (*run)(void);
+} tests[] = {
+    { "font_cache_limit", test_font_cache_limit },
+    { "style_edit", test_style_edit },
+    { "prerender", test_prerender },
+    { "roi", test_roi },
+    { "multi", test_multi },
+    { "text_edit", test_text_edit },
+};
+
+int main(int argc, char *argv[])
+{
+    const char *srcdir = getenv("srcdir");
+    int i, failed = 0;
+
+    snprintf(font_path, sizeof(font_path), "%s/%s",
+             srcdir ? srcdir : ".", FONT_FILE);
+
+    library = ass_library_init();
+    if (!library) {
+        printf("ass_library_init failed!\n");
+        return 1;
+    }
+    ass_set_message_cb(library, msg_callback, NULL);
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+        int result = tests[i].run();
+        printf("%s %s\n", result ? "FAIL" : "PASS", tests[i].name);
+        failed |= result;
+    }
+
+    ass_library_done(library);
+    return failed;
+}
@@ -0,0 +1,508 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Golden-image regression test.  The case directory contains a "cases"
+ * file with one line per script:
+ *
+ *     <name> <time> [<time> ...]
+ *
+ * Every <name>.ass is rendered at the given times (in seconds) and each
+ * frame is compared with <name>-<ms>.png.  A frame fails if too many
+ * pixels differ by more than a small tolerance; it is then written to the
+ * current directory for inspection.
+ *
+ * Text is rendered with the font in fonts/ and fontconfig disabled, using
+ * simple shaping, so that the references do not depend on the installed
+ * fonts or on whether HarfBuzz is available.
+ *
+ * The render time of each case, best of a few runs, is divided by the
+ * render time of the first case, measured the same way in the same run.
+ * This ratio is compared with the one recorded in the "timings" file, and
+ * a case that became much slower relative to the first one fails as well.
+ * Ratios carry over between machines far better than absolute times; a
+ * slowdown that hits every case alike is left to the benchmarks.
+ *
+ * With -u, the reference images and timings are written instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <ass.h>
+#include <png.h>
+
+#define FRAME_W 640
+#define FRAME_H 360
+#define MAX_CASES 64
+#define MAX_TIMES 16
+#define MAX_NAME 64
+#define RUNS 5                  // render time is the best of this many
+#define PIXEL_TOLERANCE 4       // per-channel difference that is ignored
+#define MAX_BAD_PIXELS 0.001    // fraction of pixels allowed to differ
+#define TIME_FACTOR 2.0         // allowed growth of the recorded time ratio
+#define FONT_FILE "fonts/Lato-Regular.ttf"
+
+typedef struct image_s {
+    int width, height, stride;
+    unsigned char *buffer;      // RGB24
+} image_t;
+
+typedef struct {
+    char name[MAX_NAME];
+    double times[MAX_TIMES];
+    int n_times;
+    double recorded_ratio;      // from the timings file, < 0 if missing
+} test_case;
+
+static void msg_callback(int level, const char *fmt, va_list va, void *data)
+{
+    if (level > 1)
+        return;
+    printf("libass: ");
+    vprintf(fmt, va);
+    printf("\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static image_t *gen_image(int width, int height)
+{
+    image_t *img = malloc(sizeof(image_t));
+    img->width = width;
+    img->height = height;
+    img->stride = width * 3;
+    img->buffer = malloc(height * width * 3);
+    memset(img->buffer, 63, img->stride * img->height);
+    return img;
+}
+
+static void free_image(image_t *img)
+{
+    if (!img)
+        return;
+    free(img->buffer);
+    free(img);
+}
+
+static int write_png(const char *fname, image_t *img)
+{
+    FILE *fp;
+    png_structp png_ptr;
+    png_infop info_ptr;
+    int k;
+
+    fp = fopen(fname, "wb");
+    if (fp == NULL) {
+        printf("PNG Error opening %s for writing!\n", fname);
+        return 1;
+    }
+
+    png_ptr =
+        png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    info_ptr = png_create_info_struct(png_ptr);
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        fclose(fp);
+        return 1;
+    }
+
+    png_init_io(png_ptr, fp);
+    png_set_IHDR(png_ptr, info_ptr, img->width, img->height,
+                 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+    png_set_bgr(png_ptr);
+    for (k = 0; k < img->height; k++)
+        png_write_row(png_ptr, img->buffer + img->stride * k);
+    png_write_end(png_ptr, info_ptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+
+    fclose(fp);
+    return 0;
+}
+
+static image_t *read_png(const char *fname)
+{
+    FILE *fp;
+    png_structp png_ptr;
+    png_infop info_ptr;
+    image_t *img = NULL;
+    int k;
+
+    fp = fopen(fname, "rb");
+    if (fp == NULL)
+        return NULL;
+
+    png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    info_ptr = png_create_info_struct(png_ptr);
+
+    if (setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        free_image(img);
+        fclose(fp);
+        return NULL;
+    }
+
+    png_init_io(png_ptr, fp);
+    png_read_info(png_ptr, info_ptr);
+    if (png_get_color_type(png_ptr, info_ptr) != PNG_COLOR_TYPE_RGB ||
+        png_get_bit_depth(png_ptr, info_ptr) != 8) {
+        printf("%s: not an 8-bit RGB image\n", fname);
+        png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+        fclose(fp);
+        return NULL;
+    }
+    png_set_bgr(png_ptr);
+
+    img = gen_image(png_get_image_width(png_ptr, info_ptr),
+                    png_get_image_height(png_ptr, info_ptr));
+    for (k = 0; k < img->height; k++)
+        png_read_row(png_ptr, img->buffer + img->stride * k, NULL);
+    png_read_end(png_ptr, NULL);
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+
+    fclose(fp);
+    return img;
+}
+
+#define _r(c)  ((c)>>24)
+#define _g(c)  (((c)>>16)&0xFF)
+#define _b(c)  (((c)>>8)&0xFF)
+#define _a(c)  ((c)&0xFF)
+
+static void blend_single(image_t * frame, ASS_Image *img)
+{
+    int x, y;
+    unsigned char opacity = 255 - _a(img->color);
+    unsigned char r = _r(img->color);
+    unsigned char g = _g(img->color);
+    unsigned char b = _b(img->color);
+
+    unsigned char *src;
+    unsigned char *dst;
+
+    src = img->bitmap;
+    dst = frame->buffer + img->dst_y * frame->stride + img->dst_x * 3;
+    for (y = 0; y < img->h; ++y) {
+        for (x = 0; x < img->w; ++x) {
+            unsigned k = ((unsigned) src[x]) * opacity / 255;
+            dst[x * 3] = (k * b + (255 - k) * dst[x * 3]) / 255;
+            dst[x * 3 + 1] = (k * g + (255 - k) * dst[x * 3 + 1]) / 255;
+            dst[x * 3 + 2] = (k * r + (255 - k) * dst[x * 3 + 2]) / 255;
+        }
+        src += img->stride;
+        dst += frame->stride;
+    }
+}
+
+static void blend(image_t * frame, ASS_Image *img)
+{
+    while (img) {
+        blend_single(frame, img);
+        img = img->next;
+    }
+}
+
+/**
+ * \brief Count pixels that differ by more than PIXEL_TOLERANCE
+ */
+static int compare_images(image_t *a, image_t *b)
+{
+    int x, y, bad = 0;
+
+    if (a->width != b->width || a->height != b->height)
+        return a->width * a->height;
+
+    for (y = 0; y < a->height; ++y) {
+        unsigned char *pa = a->buffer + y * a->stride;
+        unsigned char *pb = b->buffer + y * b->stride;
+        for (x = 0; x < a->width * 3; x += 3) {
+            int c;
+            for (c = 0; c < 3; ++c)
+                if (abs(pa[x + c] - pb[x + c]) > PIXEL_TOLERANCE)
+                    break;
+            bad += c < 3;
+        }
+    }
+    return bad;
+}
+
+static int read_cases(const char *dir, test_case *cases)
+{
+    char path[4096], line[1024];
+    FILE *fp;
+    int n = 0;
+
+    snprintf(path, sizeof(path), "%s/cases", dir);
+    fp = fopen(path, "r");
+    if (!fp) {
+        printf("cannot open %s\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        test_case *c = cases + n;
+        char *tok = strtok(line, " \t\r\n");
+        if (!tok || *tok == '#')
+            continue;
+        if (n == MAX_CASES) {
+            printf("%s: too many cases\n", path);
+            break;
+        }
+        snprintf(c->name, sizeof(c->name), "%s", tok);
+        c->n_times = 0;
+        c->recorded_ratio = -1;
+        while ((tok = strtok(NULL, " \t\r\n")) && c->n_times < MAX_TIMES)
+            c->times[c->n_times++] = strtod(tok, NULL);
+        if (c->n_times)
+            n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+static void read_timings(const char *dir, test_case *cases, int n_cases)
+{
+    char path[4096], name[MAX_NAME];
+    double ratio;
+    FILE *fp;
+    int i;
+
+    snprintf(path, sizeof(path), "%s/timings", dir);
+    fp = fopen(path, "r");
+    if (!fp)
+        return;
+    while (fscanf(fp, "%63s %lf", name, &ratio) == 2)
+        for (i = 0; i < n_cases; ++i)
+            if (!strcmp(cases[i].name, name))
+                cases[i].recorded_ratio = ratio;
+    fclose(fp);
+}
+
+static int write_timings(const char *dir, test_case *cases, int n_cases)
+{
+    char path[4096];
+    FILE *fp;
+    int i;
+
+    snprintf(path, sizeof(path), "%s/timings", dir);
+    fp = fopen(path, "w");
+    if (!fp) {
+        printf("cannot write %s\n", path);
+        return 1;
+    }
+    for (i = 0; i < n_cases; ++i)
+        fprintf(fp, "%s %.3f\n", cases[i].name, cases[i].recorded_ratio);
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * \brief Render all frames of a case
+ * A new renderer is used for every run, so that each run starts with
+ * empty caches.  Only ass_render_frame is timed.
+ * \param frames receives the blended frames
+ * \return best total render time in ms, or -1 on error
+ */
+static double render_case(ASS_Library *library, const char *dir,
+                          test_case *c, image_t **frames)
+{
+    char path[4096], font[4096];
+    double best = -1;
+    int run, i;
+
+    snprintf(path, sizeof(path), "%s/%s.ass", dir, c->name);
+    snprintf(font, sizeof(font), "%s/%s", dir, FONT_FILE);
+    for (run = 0; run < RUNS; ++run) {
+        ASS_Renderer *renderer = ass_renderer_init(library);
+        ASS_Track *track;
+        double total = 0;
+
+        if (!renderer) {
+            printf("ass_renderer_init failed!\n");
+            return -1;
+        }
+        ass_set_frame_size(renderer, FRAME_W, FRAME_H);
+        ass_set_fonts(renderer, font, NULL, 0, NULL, 0);
+        ass_set_shaper(renderer, ASS_SHAPING_SIMPLE);
+
+        track = ass_read_file(library, path, NULL);
+        if (!track) {
+            printf("%s: cannot read script\n", path);
+            ass_renderer_done(renderer);
+            return -1;
+        }
+
+        for (i = 0; i < c->n_times; ++i) {
+            ASS_Image *img;
+            double start = now();
+            img = ass_render_frame(renderer, track,
+                                   (long long) (c->times[i] * 1000 + 0.5),
+                                   NULL);
+            total += now() - start;
+            if (run == 0) {
+                frames[i] = gen_image(FRAME_W, FRAME_H);
+                blend(frames[i], img);
+            }
+        }
+
+        ass_free_track(track);
+        ass_renderer_done(renderer);
+        if (best < 0 || total < best)
+            best = total;
+    }
+    return best;
+}
+
+/**
+ * \brief Render a case and check its frames and render time
+ * \param base_ms render time of the first case, 0 while it is running and
+ * -1 if it failed
+ */
+static int run_case(ASS_Library *library, const char *dir, test_case *c,
+                    int update, double time_factor, double *base_ms)
+{
+    image_t *frames[MAX_TIMES];
+    char path[4096];
+    double ms, ratio;
+    int i, failed = 0;
+
+    ms = render_case(library, dir, c, frames);
+    if (!*base_ms)
+        *base_ms = ms > 0 ? ms : -1;
+    if (ms < 0) {
+        printf("FAIL %s\n", c->name);
+        return 1;
+    }
+    ratio = *base_ms > 0 ? ms / *base_ms : -1;
+
+    for (i = 0; i < c->n_times; ++i) {
+        int t = (int) (c->times[i] * 1000 + 0.5);
+        image_t *ref;
+        int bad;
+
+        snprintf(path, sizeof(path), "%s/%s-%d.png", dir, c->name, t);
+        if (update) {
+            failed |= write_png(path, frames[i]);
+            continue;
+        }
+
+        ref = read_png(path);
+        if (!ref) {
+            printf("FAIL %s: cannot read %s\n", c->name, path);
+            failed = 1;
+            continue;
+        }
+        bad = compare_images(frames[i], ref);
+        if (bad > MAX_BAD_PIXELS * FRAME_W * FRAME_H) {
+            snprintf(path, sizeof(path), "%s-%d-out.png", c->name, t);
+            printf("FAIL %s: frame at %d ms differs in %d pixels, "
+                   "see %s\n", c->name, t, bad, path);
+            write_png(path, frames[i]);
+            failed = 1;
+        }
+        free_image(ref);
+    }
+
+    for (i = 0; i < c->n_times; ++i)
+        free_image(frames[i]);
+
+    if (update) {
+        c->recorded_ratio = ratio;
+        printf("%-4s %-16s %8.2f ms, ratio %.3f\n", failed ? "FAIL" : "OK",
+               c->name, ms, ratio);
+    } else if (c->recorded_ratio > 0 && ratio > 0 && time_factor > 0 &&
+               ratio > c->recorded_ratio * time_factor) {
+        printf("FAIL %-16s %8.2f ms, ratio %.3f, recorded %.3f\n", c->name,
+               ms, ratio, c->recorded_ratio);
+        failed = 1;
+    } else if (!failed) {
+        printf("PASS %-16s %8.2f ms, ratio %.3f", c->name, ms, ratio);
+        if (c->recorded_ratio > 0)
+            printf(", recorded %.3f", c->recorded_ratio);
+        printf("\n");
+    }
+    return failed;
+}
+
+static void usage(const char *prog)
+{
+    printf("usage: %s [-u] [-t factor] <case directory>\n"
+           "  -u         write reference images and timings\n"
+           "  -t factor  allowed growth of the render time relative to the\n"
+           "             first case, against the recorded ratio;\n"
+           "             0 disables the check (default %.1f)\n",
+           prog, TIME_FACTOR);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    test_case cases[MAX_CASES];
+    double time_factor = TIME_FACTOR, base_ms = 0;
+    ASS_Library *library;
+    int update = 0, n_cases, failed = 0;
+    int opt, i;
+    const char *dir;
+
+    while ((opt = getopt(argc, argv, "ut:")) != -1) {
+        switch (opt) {
+        case 'u':
+            update = 1;
+            break;
+        case 't':
+            time_factor = strtod(optarg, NULL);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+        usage(argv[0]);
+    dir = argv[optind];
+
+    n_cases = read_cases(dir, cases);
+    if (n_cases <= 0)
+        return 1;
+    read_timings(dir, cases, n_cases);
+
+    library = ass_library_init();
+    if (!library) {
+        printf("ass_library_init failed!\n");
+        return 1;
+    }
+    ass_set_message_cb(library, msg_callback, NULL);
+
+    for (i = 0; i < n_cases; ++i)
+        failed |= run_case(library, dir, &cases[i], update, time_factor,
+                           &base_ms);
+
+    if (update)
+        failed |= write_timings(dir, cases, n_cases);
+
+    ass_library_done(library);
+
+    return failed;
+}
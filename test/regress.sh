@@ -0,0 +1,5 @@
+#!/bin/sh
+# Run the golden-image regression test from "make check".
+# REGRESS_TIME_FACTOR=0 disables the render time check, e.g. on busy
+# build machines.
+exec ./regress -t "${REGRESS_TIME_FACTOR:-2}" "${srcdir:-.}/golden"
@@ -0,0 +1,171 @@
+/*
+ * This file is part of libass.
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Stress test for concurrent chunk ingestion: producer threads queue
+ * Matroska-style chunks with ass_queue_chunk while the main thread keeps
+ * rendering the same track.  Every producer also resends some chunks to
+ * exercise duplicate detection.  Fails if the final track does not
+ * contain exactly one event per unique ReadOrder.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include <ass.h>
+
+#define N_PRODUCERS 4
+#define CHUNKS_PER_PRODUCER 5000
+#define EVENT_SPACING 40
+
+static const char header[] =
+    "[Script Info]\n"
+    "ScriptType: v4.00+\n"
+    "PlayResX: 1280\n"
+    "PlayResY: 720\n"
+    "\n"
+    "[V4+ Styles]\n"
+    "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, "
+    "OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, "
+    "ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, "
+    "Alignment, MarginL, MarginR, MarginV, Encoding\n"
+    "Style: Default,Sans,40,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,"
+    "0,0,0,0,100,100,0,0,1,2,0,2,20,20,20,1\n"
+    "\n"
+    "[Events]\n"
+    "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, "
+    "Effect, Text\n";
+
+ASS_Library *ass_library;
+ASS_Renderer *ass_renderer;
+ASS_Track *track;
+
+static pthread_mutex_t done_lock = PTHREAD_MUTEX_INITIALIZER;
+static int producers_done;
+
+void msg_callback(int level, const char *fmt, va_list va, void *data)
+{
+    if (level > 1)
+        return;
+    printf("libass: ");
+    vprintf(fmt, va);
+    printf("\n");
+}
+
+static void *producer(void *arg)
+{
+    int id = (int) (intptr_t) arg;
+    char buf[256];
+    int i;
+
+    for (i = 0; i < CHUNKS_PER_PRODUCER; ++i) {
+        // interleave the producers' ReadOrder ranges
+        int read_order = i * N_PRODUCERS + id;
+        int len = snprintf(buf, sizeof(buf),
+                "%d,%d,Default,,0,0,0,,{\\fs%d}Event %d from producer %d",
+                read_order, i & 1, 30 + (i & 15), read_order, id);
+        ass_queue_chunk(track, buf, len,
+                        (long long) read_order * EVENT_SPACING / N_PRODUCERS,
+                        EVENT_SPACING * 3);
+        // resend every 10th chunk
+        if (i % 10 == 0)
+            ass_queue_chunk(track, buf, len,
+                    (long long) read_order * EVENT_SPACING / N_PRODUCERS,
+                    EVENT_SPACING * 3);
+        // spread the chunks over many frames
+        if (i % 16 == 0) {
+            struct timespec ts = { 0, 200000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    pthread_mutex_lock(&done_lock);
+    producers_done++;
+    pthread_mutex_unlock(&done_lock);
+    return NULL;
+}
+
+static int all_done(void)
+{
+    int done;
+    pthread_mutex_lock(&done_lock);
+    done = producers_done == N_PRODUCERS;
+    pthread_mutex_unlock(&done_lock);
+    return done;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[N_PRODUCERS];
+    long long now = 0;
+    int frames = 0;
+    int i, expected, n_events;
+
+    ass_library = ass_library_init();
+    if (!ass_library) {
+        printf("ass_library_init failed!\n");
+        return 1;
+    }
+    ass_set_message_cb(ass_library, msg_callback, NULL);
+
+    ass_renderer = ass_renderer_init(ass_library);
+    if (!ass_renderer) {
+        printf("ass_renderer_init failed!\n");
+        return 1;
+    }
+    ass_set_frame_size(ass_renderer, 640, 360);
+    ass_set_fonts(ass_renderer, NULL, "Sans", 1, NULL, 1);
+
+    track = ass_new_track(ass_library);
+    ass_process_codec_private(track, (char *) header, strlen(header));
+
+    for (i = 0; i < N_PRODUCERS; ++i)
+        if (pthread_create(threads + i, NULL, producer,
+                           (void *) (intptr_t) i)) {
+            printf("pthread_create failed!\n");
+            return 1;
+        }
+
+    // render until all producers are done, following the newest events
+    while (!all_done()) {
+        int n;
+        ass_render_frame(ass_renderer, track, now, NULL);
+        frames++;
+        n = track->n_events;
+        if (n)
+            now = track->events[n - 1].Start;
+    }
+    for (i = 0; i < N_PRODUCERS; ++i)
+        pthread_join(threads[i], NULL);
+
+    // pick up whatever was queued after the last frame
+    ass_render_frame(ass_renderer, track, now, NULL);
+
+    expected = N_PRODUCERS * CHUNKS_PER_PRODUCER;
+    n_events = track->n_events;
+    printf("%d frames rendered, %d events, %d expected\n", frames,
+           n_events, expected);
+
+    ass_free_track(track);
+    ass_renderer_done(ass_renderer);
+    ass_library_done(ass_library);
+
+    return n_events == expected ? 0 : 1;
+}